@@ -0,0 +1,230 @@
+/**
+ * @file    accumulator.cc
+ * @brief   Implementation of the append-only Merkle accumulator
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#include "accumulator.hh"
+
+#include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+#include <utility>
+
+using ui64 = uint64_t;
+
+static constexpr ui64 H = MerkleAccumulator::HASH_SIZE;
+
+/**
+ * @brief the largest power of two less than w, w > 1: the size of the left subtree of w entries
+ */
+static ui64 split(const ui64 w) { return 1ULL << (63 - __builtin_clzll(w - 1)); }
+
+static void hash_children(void const* left, void const* right, void* out) {
+  uint8_t m[1 + 2 * H];
+  m[0] = 0x01;
+  memcpy(m + 1, left, H), memcpy(m + 1 + H, right, H);
+  Streebog{Streebog::Mode::H256}(m, sizeof(m), out);
+}
+
+ui64 MerkleAccumulator::slot(const ui64 first, const ui64 width) {
+  const ui64 l = __builtin_ctzll(width);
+  return ((first >> l) << (l + 1)) + width - 1;
+}
+
+void MerkleAccumulator::leaf_hash(void const* entry, const ui64 size, void* out) {
+  StreebogStream s{Streebog::Mode::H256};
+  const uint8_t tag = 0x00;
+  s.update(&tag, 1), s.update(entry, size);
+  s.finalize(out);
+}
+
+void MerkleAccumulator::append(const ui64 added, void const* const* entries, ui64 const* sizes) {
+  if (!added) return;
+  const ui64 n0 = count, n1 = count + added;
+  nodes.resize((2 * n1 - 1) * H);
+
+  // the batch kernel takes contiguous messages, so the entries are copied behind their tags
+  ui64 total{};
+  for (ui64 i{}; i < added; i++) total += sizes[i] + 1;
+  std::vector<uint8_t> msg(total);
+  std::vector<void const*> ptr(added);
+  std::vector<void*> out(added);
+  std::vector<ui64> len(added);
+  for (ui64 i{}, off{}; i < added; off += sizes[i] + 1, i++) {
+    msg[off] = 0x00;
+    memcpy(msg.data() + off + 1, entries[i], sizes[i]);
+    ptr[i] = msg.data() + off, len[i] = sizes[i] + 1, out[i] = nodes.data() + slot(n0 + i, 1) * H;
+  }
+  streebog_batch(Streebog::Mode::H256, added, ptr.data(), len.data(), out.data());
+
+  // subtrees of 2^l entries completed by this batch, a level at a time
+  for (ui64 l = 1; (1ULL << l) <= n1; l++) {
+    const ui64 from = n0 >> l, to = n1 >> l, half = 1ULL << (l - 1);
+    if (from == to) break;  // none on this level, so none above
+    msg.resize((to - from) * (1 + 2 * H)), ptr.resize(to - from), out.resize(to - from);
+    len.assign(to - from, 1 + 2 * H);
+    for (ui64 i = from; i < to; i++) {
+      uint8_t* m = msg.data() + (i - from) * (1 + 2 * H);
+      m[0] = 0x01;
+      memcpy(m + 1, subtree(2 * i * half, half), H), memcpy(m + 1 + H, subtree((2 * i + 1) * half, half), H);
+      ptr[i - from] = m, out[i - from] = nodes.data() + slot(i << l, 1ULL << l) * H;
+    }
+    streebog_batch(Streebog::Mode::H256, to - from, ptr.data(), len.data(), out.data());
+  }
+  count = n1;
+
+  right_edge(count, edge);
+}
+
+void MerkleAccumulator::right_edge(const ui64 n, Edge& e) const {
+  // the tree is a row of complete subtrees of decreasing size, every suffix of the row is a node
+  std::vector<std::pair<ui64, ui64>> row;  // first entry and width
+  for (ui64 bit = 1ULL << 63, first{}; bit; bit >>= 1)
+    if (n & bit) row.push_back({first, bit}), first += bit;
+  e.first.resize(row.empty() ? 0 : row.size() - 1), e.roots.resize(e.first.size() * H);
+  for (ui64 j = e.first.size(); j--;) {
+    e.first[j] = row[j].first;
+    auto right = (j + 2 == row.size() ? subtree(row[j + 1].first, row[j + 1].second) : &e.roots[(j + 1) * H]);
+    hash_children(subtree(row[j].first, row[j].second), right, &e.roots[j * H]);
+  }
+}
+
+MerkleAccumulator::Edge const& MerkleAccumulator::edge_of(const ui64 n, Edge& tmp) const {
+  if (n == count) return edge;
+  right_edge(n, tmp);
+  return tmp;
+}
+
+void MerkleAccumulator::range_root(const ui64 lo, const ui64 hi, Edge const& e, uint8_t* out) const {
+  const ui64 w = hi - lo;
+  if (!(w & (w - 1))) {  // a complete subtree: lo is a multiple of w wherever the RFC 6962 split leads
+    memcpy(out, subtree(lo, w), H);
+    return;
+  }
+  for (ui64 j{}; j < e.first.size(); j++)  // any other node of the split is a suffix of the row of its tree
+    if (e.first[j] == lo) {
+      memcpy(out, &e.roots[j * H], H);
+      return;
+    }
+
+  uint8_t right[H];
+  const ui64 k = split(w);
+  range_root(lo + k, hi, e, right);
+  hash_children(subtree(lo, k), right, out);
+}
+
+int MerkleAccumulator::root(const ui64 n, void* out) const {
+  if (n > count) return EINVAL;
+  uint8_t empty[1];
+  if (!n)
+    Streebog{Streebog::Mode::H256}(empty, 0, out);
+  else {
+    Edge tmp;
+    range_root(0, n, edge_of(n, tmp), (uint8_t*)out);
+  }
+  return 0;
+}
+
+int MerkleAccumulator::leaf(const ui64 i, void* out) const {
+  if (i >= count) return EINVAL;
+  memcpy(out, subtree(i, 1), H);
+  return 0;
+}
+
+int MerkleAccumulator::prove_inclusion(const ui64 i, const ui64 n, std::vector<uint8_t>& proof) const {
+  if (i >= n || n > count) return EINVAL;
+
+  // PATH(i, D[n]) of RFC 6962, 2.1.1, unrolled from the top
+  std::vector<std::pair<ui64, ui64>> siblings;
+  for (ui64 lo{}, hi = n; hi - lo > 1;) {
+    const ui64 k = split(hi - lo);
+    if (i < lo + k)
+      siblings.push_back({lo + k, hi}), hi = lo + k;
+    else
+      siblings.push_back({lo, lo + k}), lo += k;
+  }
+  Edge tmp;
+  auto& e = edge_of(n, tmp);
+  proof.resize(siblings.size() * H);  // from the leaf up
+  for (ui64 j{}; j < siblings.size(); j++)
+    range_root(siblings[j].first, siblings[j].second, e, &proof[proof.size() - (j + 1) * H]);
+  return 0;
+}
+
+int MerkleAccumulator::prove_consistency(const ui64 m, const ui64 n, std::vector<uint8_t>& proof) const {
+  if (!m || m > n || n > count) return EINVAL;
+
+  // SUBPROOF(m, D[n], true) of RFC 6962, 2.1.2, unrolled from the top
+  std::vector<std::pair<ui64, ui64>> ranges;
+  bool whole = true;  // the range starts at entry 0: the node of the old tree is its root, the verifier has it
+  for (ui64 lo{}, hi = n, left = m; m != n;) {
+    if (left == hi - lo) {
+      if (!whole) ranges.push_back({lo, hi});
+      break;
+    }
+    const ui64 k = split(hi - lo);
+    if (left <= k)
+      ranges.push_back({lo + k, hi}), hi = lo + k;
+    else
+      ranges.push_back({lo, lo + k}), lo += k, left -= k, whole = false;
+  }
+  Edge tmp;
+  auto& e = edge_of(n, tmp);
+  proof.resize(ranges.size() * H);  // from the leaf up
+  for (ui64 j{}; j < ranges.size(); j++)
+    range_root(ranges[j].first, ranges[j].second, e, &proof[proof.size() - (j + 1) * H]);
+  return 0;
+}
+
+bool MerkleAccumulator::verify_inclusion(void const* leaf, const ui64 i, const ui64 n, void const* root,
+                                         void const* proof, const ui64 proof_size) {
+  if (i >= n || proof_size % H) return false;
+
+  // RFC 9162, 2.1.3.2
+  auto p = (uint8_t const*)proof;
+  uint8_t r[H];
+  memcpy(r, leaf, H);
+  ui64 fn = i, sn = n - 1;
+  for (ui64 off{}; off < proof_size; off += H, fn >>= 1, sn >>= 1) {
+    if (!sn) return false;
+    if ((fn & 1) || fn == sn) {
+      hash_children(p + off, r, r);
+      while (!(fn & 1) && fn) fn >>= 1, sn >>= 1;
+    } else {
+      hash_children(r, p + off, r);
+    }
+  }
+  return !sn && !memcmp(r, root, H);
+}
+
+bool MerkleAccumulator::verify_consistency(const ui64 m, const ui64 n, void const* old_root, void const* new_root,
+                                           void const* proof, const ui64 proof_size) {
+  if (!m || m > n || proof_size % H) return false;
+  if (m == n) return !proof_size && !memcmp(old_root, new_root, H);
+  if (!proof_size) return false;
+
+  // RFC 9162, 2.1.4.2; a tree of 2^k entries is a node of the new one, and the proof leaves its root out
+  std::vector<uint8_t> path;
+  if (!(m & (m - 1))) path.assign((uint8_t const*)old_root, (uint8_t const*)old_root + H);
+  path.insert(path.end(), (uint8_t const*)proof, (uint8_t const*)proof + proof_size);
+
+  ui64 fn = m - 1, sn = n - 1;
+  while (fn & 1) fn >>= 1, sn >>= 1;
+  uint8_t fr[H], sr[H];
+  memcpy(fr, path.data(), H), memcpy(sr, path.data(), H);
+  for (ui64 off = H; off < path.size(); off += H, fn >>= 1, sn >>= 1) {
+    if (!sn) return false;
+    if ((fn & 1) || fn == sn) {
+      hash_children(&path[off], fr, fr), hash_children(&path[off], sr, sr);
+      while (!(fn & 1) && fn) fn >>= 1, sn >>= 1;
+    } else {
+      hash_children(sr, &path[off], sr);
+    }
+  }
+  return !sn && !memcmp(fr, old_root, H) && !memcmp(sr, new_root, H);
+}
@@ -0,0 +1,76 @@
+/**
+ * @file    mmap_bench.cc
+ * @brief   Benchmark of file mapping: the plain whole-file map vs windowed hash_fd_mmap()
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+
+#include "file.hh"
+
+using ui64 = uint64_t;
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s FILE [repeats]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  const int repeats = (argc > 2 ? atoi(argv[2]) : 3);
+
+  const int fd = open(argv[1], O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st)) {
+    perror(argv[1]);
+    return EXIT_FAILURE;
+  }
+
+  struct {
+    const char* name;
+    MmapConfig cfg;
+  } const runs[] = {
+      {"whole file, no hints", {0, false, false, false, false}},
+      {"whole file, sequential", {0, true, false, false, true}},
+      {"64MB windows", {}},
+      {"64MB windows, populate", {1ULL << 26, true, false, true, true}},
+      {"64MB windows, hugepage", {1ULL << 26, true, true, false, true}},
+      {"8MB windows", {1ULL << 23, true, false, false, true}},
+  };
+
+  uint8_t first[64], out[64];
+  printf("%s: %llu bytes, best of %d\n", argv[1], (unsigned long long)st.st_size, repeats);
+  for (auto& r : runs) {
+    double best = 1e30;
+    rusage ru0, ru1;
+    getrusage(RUSAGE_SELF, &ru0);
+    for (int i{}; i < repeats; i++) {
+      lseek(fd, 0, SEEK_SET);
+      auto t0 = std::chrono::steady_clock::now();
+      if (auto err = hash_fd_mmap(fd, Streebog::Mode::H512, out, r.cfg)) {
+        fprintf(stderr, "%s: %s\n", argv[1], strerror(err));
+        return EXIT_FAILURE;
+      }
+      auto t = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+      best = (t < best ? t : best);
+    }
+    getrusage(RUSAGE_SELF, &ru1);
+
+    if (&r == runs) memcpy(first, out, 64);
+    printf("%-24s: %8.1f MB/s, %8ld page faults per run%s\n", r.name, st.st_size / best / 1e6,
+           (ru1.ru_minflt - ru0.ru_minflt + ru1.ru_majflt - ru0.ru_majflt) / repeats,
+           (memcmp(first, out, 64) ? ", DIGEST MISMATCH" : ""));
+  }
+
+  close(fd);
+  return EXIT_SUCCESS;
+}
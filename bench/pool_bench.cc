@@ -0,0 +1,66 @@
+/**
+ * @file    pool_bench.cc
+ * @brief   Benchmark of short-lived contexts: heap allocation vs ContextPool
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "pool.hh"
+
+using ui64 = uint64_t;
+
+template <typename F>
+double run_threads(const unsigned threads, F&& f) {
+  auto t0 = std::chrono::steady_clock::now();
+  std::vector<std::thread> th;
+  for (unsigned i{}; i < threads; i++) th.emplace_back(f);
+  for (auto& t : th) t.join();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+int main(int argc, char** argv) {
+  const unsigned threads = (argc > 1 ? atoi(argv[1]) : std::thread::hardware_concurrency());
+  const ui64 iters = (argc > 2 ? atoll(argv[2]) : 1000000);
+  const ui64 live = 16;  ///< contexts held by a thread at once
+
+  auto heap = run_threads(threads, [&] {
+    std::unique_ptr<Streebog> ctx[live];
+    for (ui64 i{}; i < iters; i++) {
+      auto& c = ctx[i % live];
+      c.reset(new Streebog{Streebog::Mode::H256});
+      asm volatile("" ::"r"(c.get()) : "memory");
+    }
+  });
+
+  StreebogPool pool{(uint32_t)(threads * live)};
+  if (!pool.capacity()) {
+    fprintf(stderr, "pool_bench: cannot allocate %llu contexts\n", (unsigned long long)(threads * live));
+    return EXIT_FAILURE;
+  }
+  auto pooled = run_threads(threads, [&] {
+    StreebogPool::Ptr ctx[live];
+    for (ui64 i{}; i < iters; i++) {
+      auto& c = ctx[i % live];
+      c.reset();
+      c = pool.acquire(Streebog::Mode::H256);
+      asm volatile("" ::"r"(c.get()) : "memory");
+    }
+  });
+
+  const double ops = (double)threads * iters;
+  printf("threads %u, %llu contexts per thread\n", threads, (unsigned long long)iters);
+  printf("heap  : %8.1f ns per context\n", heap * 1e9 / ops);
+  printf("pool  : %8.1f ns per context\n", pooled * 1e9 / ops);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,90 @@
+/**
+ * @file    store_bench.cc
+ * @brief   Benchmark of ChunkStore ingestion: throughput by the number of hashing threads and deduplication
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "store.hh"
+
+using ui64 = uint64_t;
+
+/**
+ * @brief writes size bytes of noise, then the same bytes with a small insertion every MB (a "next backup")
+ */
+static int make_input(const ui64 size) {
+  char tmpl[] = "/tmp/store_bench_XXXXXX";
+  const int fd = mkstemp(tmpl);
+  if (fd < 0) return -1;
+  unlink(tmpl);
+
+  std::vector<uint8_t> v(size);
+  uint64_t x = 88172645463325252ULL;
+  for (auto& b : v) x ^= x << 13, x ^= x >> 7, x ^= x << 17, b = x;
+  bool ok = write(fd, v.data(), size) == (ssize_t)size;
+  for (ui64 off{}; ok && off < size; off += 1 << 20) {
+    const ui64 n = (size - off < (1 << 20) ? size - off : (1 << 20));
+    ok = write(fd, "edit", 4) == 4 && write(fd, v.data() + off, n) == (ssize_t)n;
+  }
+  return (ok ? fd : -1);
+}
+
+int main(int argc, char** argv) {
+  const ui64 size = (argc > 1 ? strtoull(argv[1], nullptr, 10) : 256) << 20;
+  const int fd = make_input(size);
+  if (fd < 0) {
+    perror("input");
+    return EXIT_FAILURE;
+  }
+  const ui64 total = lseek(fd, 0, SEEK_END);
+
+  std::vector<unsigned> threads;
+  for (unsigned t = 1; t <= std::thread::hardware_concurrency(); t *= 2) threads.push_back(t);
+  if (threads.back() != std::thread::hardware_concurrency()) threads.push_back(std::thread::hardware_concurrency());
+
+  printf("%llu MB: %llu MB of noise, then the same with 4 bytes inserted every MB\n",
+         (unsigned long long)(total >> 20), (unsigned long long)(size >> 20));
+  for (auto t : threads) {
+    char tmpl[] = "/tmp/store_bench_XXXXXX";
+    std::string dir = mkdtemp(tmpl);
+    ChunkStore::Config cfg;
+    cfg.threads = t;
+
+    std::vector<ChunkRef> recipe;
+    StoreStats st{};
+    double s;
+    {
+      ChunkStore store{dir.c_str(), cfg};
+      lseek(fd, 0, SEEK_SET);
+      auto t0 = std::chrono::steady_clock::now();
+      const int err = (store.status() ? store.status() : store.put(fd, recipe, &st));
+      if (!err) store.flush();
+      s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+      if (err) {
+        fprintf(stderr, "%s: %s\n", dir.c_str(), strerror(err));
+        return EXIT_FAILURE;
+      }
+    }
+    printf("%3u threads: %8.1f MB/s, %llu chunks, %5.1f%% stored\n", t, total / s / 1e6,
+           (unsigned long long)st.chunks, 100.0 * st.new_bytes / st.bytes);
+
+    std::string cmd = "rm -rf " + dir;
+    if (system(cmd.c_str())) return EXIT_FAILURE;
+  }
+
+  close(fd);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,71 @@
+/**
+ * @file    tree_bench.cc
+ * @brief   Benchmark of the Streebog-Tree hash: throughput by the number of threads against the standard hash
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <chrono>
+
+#include "file.hh"
+#include "tree.hh"
+
+using ui64 = uint64_t;
+
+/**
+ * @brief best of reps runs of f, in MB/s
+ */
+template <typename F>
+static double best(const int fd, const ui64 size, const int reps, F f) {
+  double s = 1e300;
+  for (int r{}; r < reps; r++) {
+    lseek(fd, 0, SEEK_SET);
+    auto t0 = std::chrono::steady_clock::now();
+    if (int e = f()) {
+      fprintf(stderr, "%s\n", strerror(e));
+      exit(EXIT_FAILURE);
+    }
+    const double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    if (t < s) s = t;
+  }
+  return size / s / 1e6;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s FILE [REPEATS] [LEAF_KB]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  const int reps = (argc > 2 ? atoi(argv[2]) : 3);
+  TreeConfig cfg;
+  if (argc > 3) cfg.leaf = strtoull(argv[3], nullptr, 10) << 10;
+
+  const int fd = open(argv[1], O_RDONLY);
+  if (fd < 0) {
+    perror(argv[1]);
+    return EXIT_FAILURE;
+  }
+  const ui64 size = lseek(fd, 0, SEEK_END);
+  alignas(32) uint8_t out[64];
+
+  printf("%s: %llu MB, leaves of %llu KB\n", argv[1], (unsigned long long)(size >> 20),
+         (unsigned long long)(cfg.leaf >> 10));
+  printf("standard:    %8.1f MB/s\n",
+         best(fd, size, reps, [&] { return hash_fd(fd, Streebog::Mode::H512, out, ReadMethod::Mmap); }));
+  for (unsigned t = 1; t <= 64; t *= 2) {
+    cfg.threads = t;
+    printf("%2u threads:  %8.1f MB/s\n", t,
+           best(fd, size, reps, [&] { return hash_fd_tree(fd, Streebog::Mode::H512, out, cfg); }));
+  }
+
+  close(fd);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,405 @@
+/**
+ * @file    delta.cc
+ * @brief   Implementation of rsync-style signatures and deltas
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#include "delta.hh"
+
+#include <endian.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+using ui64 = uint64_t;
+
+static constexpr char SIG_MAGIC[8] = {'s', 't', 'b', 'g', 's', 'i', 'g', '1'};
+static constexpr char DELTA_MAGIC[8] = {'s', 't', 'b', 'g', 'd', 'l', 't', '1'};
+static constexpr uint8_t OP_COPY = 'C', OP_LITERAL = 'L', OP_END = 'E';  ///< delta operations
+
+static constexpr ui64 IO_SIZE = 1ULL << 20;    ///< buffer of the signature reader, the writer and the patcher
+static constexpr ui64 SCAN_SIZE = 1ULL << 22;  ///< min window of the new file kept in memory by make_delta()
+static constexpr ui64 MAX_BLOCK = 1ULL << 24;  ///< larger blocks would make the scan window too large
+static constexpr ui64 BATCH = 8;               ///< max windows hashed at once when a run of blocks matches
+static constexpr uint32_t CHAR_OFFSET = 31;    ///< added to every byte of the weak sum, as in rsync
+static constexpr ui64 NONE = ~0ULL;
+
+namespace {
+  /**
+   * @brief weak sum of rsync: a = sum of the bytes, b = sum of the prefix sums, both mod 2^16
+   */
+  struct Rolling {
+    uint32_t a, b, n;
+
+    void init(uint8_t const* p, const ui64 len) {
+      a = b = 0, n = len;
+      for (ui64 i{}; i < len; i++) a += p[i] + CHAR_OFFSET, b += a;
+    }
+
+    void roll(const uint8_t out, const uint8_t in) {
+      a += (uint32_t)in - out;
+      b += a - n * (out + CHAR_OFFSET);
+    }
+
+    uint32_t value() const { return (a & 0xFFFF) | (b << 16); }
+  };
+
+  uint32_t weak_sum(uint8_t const* p, const ui64 len) {
+    Rolling r;
+    r.init(p, len);
+    return r.value();
+  }
+
+  struct Digest {
+    uint8_t b[32];
+  };
+
+  int read_full(const int fd, uint8_t* p, const ui64 size, ui64& got) {
+    got = 0;
+    while (got < size) {
+      auto n = read(fd, p + got, size - got);
+      if (n < 0 && errno == EINTR) continue;
+      if (n < 0) return errno;
+      if (!n) break;
+      got += n;
+    }
+    return 0;
+  }
+
+  int write_full(const int fd, uint8_t const* p, ui64 size) {
+    while (size) {
+      auto n = write(fd, p, size);
+      if (n < 0 && errno == EINTR) continue;
+      if (n < 0) return errno;
+      p += n, size -= n;
+    }
+    return 0;
+  }
+
+  /**
+   * @brief buffered sequential writer remembering the first error
+   */
+  struct Writer {
+    int fd;
+    int err{};
+    std::vector<uint8_t> buf = std::vector<uint8_t>(IO_SIZE);
+    ui64 len{};
+
+    void put(void const* p, const ui64 n) {
+      if (err) return;
+      if (len + n > buf.size()) flush();
+      if (n >= buf.size()) {
+        if (!err) err = write_full(fd, (uint8_t const*)p, n);
+        return;
+      }
+      memcpy(buf.data() + len, p, n);
+      len += n;
+    }
+
+    void put8(const uint8_t v) { put(&v, 1); }
+    void put32(const uint32_t v) {
+      const uint32_t le = htole32(v);
+      put(&le, 4);
+    }
+    void put64(const ui64 v) {
+      const ui64 le = htole64(v);
+      put(&le, 8);
+    }
+
+    int flush() {
+      if (!err && len) err = write_full(fd, buf.data(), len);
+      len = 0;
+      return err;
+    }
+  };
+
+  /**
+   * @brief buffered sequential reader; running out of data in the middle of a field is EBADMSG
+   */
+  struct Reader {
+    int fd;
+    std::vector<uint8_t> buf = std::vector<uint8_t>(IO_SIZE);
+    ui64 pos{}, len{};
+
+    int get(void* _p, ui64 n) {
+      auto p = (uint8_t*)_p;
+      while (n) {
+        if (pos == len) {
+          pos = 0;
+          if (int e = read_full(fd, buf.data(), buf.size(), len)) return e;
+          if (!len) return EBADMSG;
+        }
+        const ui64 k = (len - pos < n ? len - pos : n);
+        memcpy(p, buf.data() + pos, k);
+        pos += k, p += k, n -= k;
+      }
+      return 0;
+    }
+
+    int get32(uint32_t& v) {
+      int e = get(&v, 4);
+      v = le32toh(v);
+      return e;
+    }
+    int get64(ui64& v) {
+      int e = get(&v, 8);
+      v = le64toh(v);
+      return e;
+    }
+  };
+
+  /**
+   * @brief delta writer merging adjacent copies
+   */
+  struct DeltaWriter {
+    Writer w;
+    ui64 copy_off{}, copy_len{};
+    DeltaStats stats{};
+
+    void flush_copy() {
+      if (!copy_len) return;
+      w.put8(OP_COPY), w.put64(copy_off), w.put64(copy_len);
+      copy_len = 0;
+    }
+
+    void copy(const ui64 off, const ui64 len) {
+      if (copy_len && copy_off + copy_len == off) {
+        copy_len += len;
+      } else {
+        flush_copy();
+        copy_off = off, copy_len = len;
+      }
+      stats.copied += len;
+    }
+
+    void literal(uint8_t const* p, const ui64 len) {
+      if (!len) return;
+      flush_copy();
+      w.put8(OP_LITERAL), w.put64(len), w.put(p, len);
+      stats.literal += len;
+    }
+  };
+}  // namespace
+
+int make_signature(const int fd, uint32_t block, uint32_t strong_len, Signature& sig) {
+  strong_len = (strong_len ? strong_len : 16);
+  if (strong_len > 32 || block > MAX_BLOCK) return EINVAL;
+
+  // the size is only known in advance for regular files, others get the smallest automatic block
+  if (!block) {
+    const off_t cur = lseek(fd, 0, SEEK_CUR), end = lseek(fd, 0, SEEK_END);
+    const ui64 size = (cur >= 0 && end >= cur && lseek(fd, cur, SEEK_SET) == cur ? end - cur : 0);
+    for (block = 1024; block < 65536 && (ui64)block * block < size;) block <<= 1;
+  }
+  block = (block + 63) & ~63U;
+
+  sig = Signature{block, strong_len, 0, {}, {}};
+  const ui64 blocks = (IO_SIZE + block - 1) / block;  ///< per read
+  std::vector<uint8_t> buf(blocks * block);
+  std::vector<Digest> dg(blocks);
+  std::vector<void const*> ptr(blocks);
+  std::vector<void*> out(blocks);
+  std::vector<ui64> size(blocks);
+
+  for (;;) {
+    ui64 got;
+    if (int e = read_full(fd, buf.data(), buf.size(), got)) return e;
+    if (!got) break;
+
+    const ui64 n = (got + block - 1) / block;
+    for (ui64 i{}; i < n; i++) {
+      size[i] = (got - i * block < block ? got - i * block : block);
+      ptr[i] = buf.data() + i * block, out[i] = dg[i].b;
+      sig.weak.push_back(weak_sum(buf.data() + i * block, size[i]));
+    }
+    streebog_batch(Streebog::Mode::H256, n, ptr.data(), size.data(), out.data());
+    for (ui64 i{}; i < n; i++) sig.strong.insert(sig.strong.end(), dg[i].b, dg[i].b + strong_len);
+
+    sig.size += got;
+    if (got < buf.size()) break;
+  }
+  return 0;
+}
+
+int write_signature(const int fd, Signature const& sig) {
+  Writer w{fd};
+  w.put(SIG_MAGIC, 8);
+  w.put32(sig.block), w.put32(sig.strong_len), w.put64(sig.size);
+  for (auto v : sig.weak) w.put32(v);
+  w.put(sig.strong.data(), sig.strong.size());
+  return w.flush();
+}
+
+int read_signature(const int fd, Signature& sig) {
+  Reader r{fd};
+  char magic[8];
+  if (int e = r.get(magic, 8)) return e;
+  if (memcmp(magic, SIG_MAGIC, 8)) return EBADMSG;
+  for (int e : {r.get32(sig.block), r.get32(sig.strong_len), r.get64(sig.size)})
+    if (e) return e;
+  if (!sig.block || sig.block % 64 || sig.block > MAX_BLOCK || !sig.strong_len || sig.strong_len > 32)
+    return EBADMSG;
+
+  // grown as the data comes, so a broken size fails at the end of the data rather than on allocation
+  const ui64 n = (sig.size + sig.block - 1) / sig.block;
+  sig.weak.clear(), sig.strong.clear();
+  for (ui64 i{}; i < n; i++) {
+    uint32_t v;
+    if (int e = r.get32(v)) return e;
+    sig.weak.push_back(v);
+  }
+  uint8_t s[32];
+  for (ui64 i{}; i < n; i++) {
+    if (int e = r.get(s, sig.strong_len)) return e;
+    sig.strong.insert(sig.strong.end(), s, s + sig.strong_len);
+  }
+  return 0;
+}
+
+int make_delta(Signature const& sig, const int fd, const int out, DeltaStats* stats) {
+  if (!sig.block || sig.block > MAX_BLOCK || !sig.strong_len || sig.strong_len > 32) return EINVAL;
+  const ui64 B = sig.block, L = sig.strong_len, full = sig.size / B, tail = sig.size % B;
+  auto strong = [&](const ui64 i) { return sig.strong.data() + i * L; };
+
+  // chained hash table of the whole blocks; chains list lower blocks first
+  ui64 bits = 4;
+  while ((1ULL << bits) < 2 * full) bits++;
+  std::vector<ui64> head(1ULL << bits, NONE), next(full);
+  auto bucket = [&](const uint32_t v) { return (v * 0x9E3779B1U) >> (32 - bits); };
+  for (ui64 i = full; i--;) next[i] = head[bucket(sig.weak[i])], head[bucket(sig.weak[i])] = i;
+
+  DeltaWriter d{Writer{out}};
+  d.w.put(DELTA_MAGIC, 8);
+
+  std::vector<uint8_t> buf(SCAN_SIZE > 2 * BATCH * B ? SCAN_SIZE : 2 * BATCH * B);
+  ui64 len{}, p{}, lit{}, total{};  ///< data, window start and start of the pending literal, all in buf
+  bool eof{}, rolling{};
+  Rolling w;
+  StreebogStream whole{Streebog::Mode::H256};
+  Digest dg[BATCH];
+
+  for (;;) {
+    if (len - p < B && !eof) {  // slide: the pending literal goes out, the partial window moves to the front
+      d.literal(buf.data() + lit, p - lit);
+      memmove(buf.data(), buf.data() + p, len - p);
+      len -= p, lit = p = 0, rolling = false;
+      ui64 got;
+      if (int e = read_full(fd, buf.data() + len, buf.size() - len, got)) return e;
+      whole.update(buf.data() + len, got);
+      len += got, total += got, eof = (len < buf.size());
+      continue;
+    }
+    if (len - p < B) break;
+
+    if (!rolling) w.init(buf.data() + p, B), rolling = true;
+    const uint32_t v = w.value();
+    ui64 first = head[bucket(v)];
+    while (first != NONE && sig.weak[first] != v) first = next[first];
+
+    if (first != NONE) {
+      // an unchanged region is a run of blocks: the windows after this one that look like the blocks after the
+      // candidate are hashed in the same batch
+      void const* ptr[BATCH];
+      void* o[BATCH];
+      ui64 size[BATCH], k = 1;
+      ptr[0] = buf.data() + p;
+      while (k < BATCH && first + k < full && p + (k + 1) * B <= len &&
+             weak_sum(buf.data() + p + k * B, B) == sig.weak[first + k])
+        ptr[k] = buf.data() + p + k * B, k++;
+      for (ui64 j{}; j < k; j++) size[j] = B, o[j] = dg[j].b;
+      streebog_batch(Streebog::Mode::H256, k, ptr, size, o);
+
+      ui64 idx = first;
+      while (idx != NONE && (sig.weak[idx] != v || memcmp(strong(idx), dg[0].b, L))) idx = next[idx];
+      if (idx != NONE) {
+        d.literal(buf.data() + lit, p - lit);
+        d.copy(idx * B, B), p += B;
+        for (ui64 j = 1; j < k && idx + j < full && !memcmp(strong(idx + j), dg[j].b, L); j++)
+          d.copy((idx + j) * B, B), p += B;
+        lit = p, rolling = false;
+        continue;
+      }
+    }
+
+    if (p + B < len)
+      w.roll(buf[p], buf[p + B]);
+    else
+      rolling = false;
+    p++;
+  }
+
+  // the short last block of the basis can only match at the very end
+  if (tail && len - p >= tail && weak_sum(buf.data() + len - tail, tail) == sig.weak[full]) {
+    void const* ptr = buf.data() + len - tail;
+    void* o = dg[0].b;
+    streebog_batch(Streebog::Mode::H256, 1, &ptr, &tail, &o);
+    if (!memcmp(strong(full), dg[0].b, L)) {
+      d.literal(buf.data() + lit, len - tail - lit);
+      d.copy(full * B, tail);
+      lit = len;
+    }
+  }
+  d.literal(buf.data() + lit, len - lit);
+  d.flush_copy();
+
+  Digest digest;
+  whole.finalize(digest.b);
+  d.w.put8(OP_END), d.w.put64(total), d.w.put(digest.b, 32);
+  if (int e = d.w.flush()) return e;
+  if (stats) *stats = d.stats;
+  return 0;
+}
+
+int apply_delta(const int basis, const int delta, const int out) {
+  Reader r{delta};
+  Writer w{out};
+  StreebogStream whole{Streebog::Mode::H256};
+  std::vector<uint8_t> tmp(IO_SIZE);
+  ui64 total{};
+
+  char magic[8];
+  if (int e = r.get(magic, 8)) return e;
+  if (memcmp(magic, DELTA_MAGIC, 8)) return EBADMSG;
+
+  for (;;) {
+    uint8_t op;
+    ui64 a, b;
+    if (int e = r.get(&op, 1)) return e;
+    if (op == OP_END) break;
+    if (op != OP_COPY && op != OP_LITERAL) return EBADMSG;
+    if (int e = r.get64(a)) return e;
+    if (op == OP_COPY)
+      if (int e = r.get64(b)) return e;
+
+    // COPY offset length: a range of the basis, LITERAL length data: the data itself
+    for (ui64 left = (op == OP_COPY ? b : a), off = a; left;) {
+      const ui64 n = (left < tmp.size() ? left : tmp.size());
+      if (op == OP_LITERAL) {
+        if (int e = r.get(tmp.data(), n)) return e;
+      } else {
+        for (ui64 got{}; got < n;) {
+          auto k = pread(basis, tmp.data() + got, n - got, off + got);
+          if (k < 0 && errno == EINTR) continue;
+          if (k < 0) return errno;
+          if (!k) return EBADMSG;  // the basis is shorter than the delta says
+          got += k;
+        }
+      }
+      whole.update(tmp.data(), n);
+      w.put(tmp.data(), n);
+      if (w.err) return w.err;
+      left -= n, off += n, total += n;
+    }
+  }
+
+  ui64 size;
+  Digest expected, digest;
+  for (int e : {r.get64(size), r.get(expected.b, 32)})
+    if (e) return e;
+  whole.finalize(digest.b);
+  if (size != total || memcmp(expected.b, digest.b, 32)) return EBADMSG;
+  return w.flush();
+}
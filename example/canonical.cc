@@ -12,6 +12,11 @@
 #include "streebog.hh"
 
 int main(int argc, char** argv) {
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s FILE\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
   int fd = open(argv[1], O_RDONLY);
   if (fd == -1) {
     perror("Ошибка при открытии файла");
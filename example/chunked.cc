@@ -1,5 +1,4 @@
 
-#include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -8,36 +7,25 @@
 
 #include <cinttypes>
 
-#include "streebog.hh"
-
-#define CHUNK_SIZE (1ull << 18)  // 256KB
+#include "file.hh"
 
 int main(int argc, char** argv) {
-  int fd = open(argv[1], O_RDONLY | O_DIRECT);
-  if (fd == -1) return 1;
-
-  char* buf;
-  if (posix_memalign((void**)&buf, 64, CHUNK_SIZE)) {
-    perror("posix_memalign");
-    close(fd);
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s FILE [CHUNK_KB]\n", argv[0]);
     return 1;
   }
 
-  Streebog stbg(Streebog::Mode::H512);
-  ssize_t bytes_read;
-  uint64_t hash[8];
+  int fd = open(argv[1], O_RDONLY);
+  if (fd == -1) return 1;
 
-  while ((bytes_read = read(fd, buf, CHUNK_SIZE)) > 0)
-    if (bytes_read < CHUNK_SIZE) {
-      auto ret = stbg.finalize((uint8_t*)buf, bytes_read);
-      memcpy(hash, ret, 64);
-    } else
-      stbg.update(buf, bytes_read);
-
-  if (bytes_read == -1) {
-    perror("read");
-    free(buf);
-    close(fd);
+  // aligned O_DIRECT reads of the body, the unaligned tail through the page cache; 0 - chunk chosen by the device
+  uint64_t chunk = (argc > 2 ? strtoull(argv[2], nullptr, 10) << 10 : 0);
+
+  uint64_t hash[8];
+  int err = hash_fd_direct(fd, Streebog::Mode::H512, hash, chunk);
+  close(fd);
+  if (err) {
+    fprintf(stderr, "read: %s\n", strerror(err));
     return 1;
   }
 
@@ -45,7 +33,5 @@ int main(int argc, char** argv) {
       printf("%016" PRIx64, hash[i]);
   printf("\n");
 
-  free(buf);
-  close(fd);
   return 0;
 }
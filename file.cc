@@ -0,0 +1,677 @@
+/**
+ * @file    file.cc
+ * @brief   Implementation of hashing of files and file descriptors
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#include "file.hh"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <semaphore>
+#include <thread>
+#include <vector>
+
+#include "uring.hh"
+
+#if defined(__SSSE3__)
+#include <immintrin.h>
+#endif
+
+using ui64 = uint64_t;
+
+static constexpr ui64 READ_SIZE = 1ULL << 20;         ///< buffer of Read and Direct methods
+static constexpr ui64 DIRECT_ALIGN = 1ULL << 12;      ///< buffer alignment suitable for O_DIRECT on any device
+static constexpr ui64 PIPE_SIZE = 1ULL << 20;         ///< pipe buffer requested with F_SETPIPE_SZ
+static constexpr ui64 MAX_DIRECT_CHUNK = 1ULL << 23;  ///< optimal I/O sizes above this are not used as a chunk
+static constexpr ui64 MAP_ALIGN = 1ULL << 21;         ///< alignment of mmap windows, a huge page
+static constexpr ui64 DROP_STEP = 1ULL << 23;         ///< hashed parts of a window are dropped in steps of this size
+static constexpr ui64 IDLE_URINGS = 4;                ///< io_uring readers kept set up while no call is using them
+
+static int hash_read(const int fd, StreebogStream& stream) {
+  void* buff;
+  if (posix_memalign(&buff, DIRECT_ALIGN, READ_SIZE)) return ENOMEM;
+
+  int err{};
+  for (;;) {
+    auto n = read(fd, buff, READ_SIZE);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) err = errno;
+    if (n <= 0) break;
+    stream.update(buff, n);
+  }
+
+  free(buff);
+  return err;
+}
+
+/**
+ * @brief hashes up to limit bytes from the current offset of fd; reads are chunk bytes long except the last one
+ */
+static int hash_pipelined(const int fd, StreebogStream& stream, PipelineConfig const& cfg, const ui64 limit = ~0ULL) {
+  const ui64 depth = (cfg.depth < 2 ? 2 : cfg.depth);
+  const ui64 chunk = (cfg.chunk + DIRECT_ALIGN - 1) & ~(DIRECT_ALIGN - 1);
+  void* pool;
+  if (posix_memalign(&pool, DIRECT_ALIGN, depth * chunk)) return ENOMEM;
+
+  struct Filled {
+    ui64 size;  ///< less than chunk only at the end of the file
+    int err;
+  };
+  std::vector<Filled> filled(depth);
+  std::counting_semaphore<> free_bufs(depth), full_bufs(0);
+  const int flags = fcntl(fd, F_GETFL);
+  const bool direct = (flags >= 0 && (flags & O_DIRECT));
+
+  std::thread reader([&] {
+    for (ui64 i{}, left = limit;; i++) {
+      free_bufs.acquire();
+      auto& f = filled[i % depth];
+      auto buff = (uint8_t*)pool + (i % depth) * chunk;
+      const ui64 want = (left < chunk ? left : chunk);
+      f = {0, 0};
+      for (ssize_t n; f.size < want;) {
+        n = read(fd, buff + f.size, want - f.size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) f.err = errno;
+        if (n <= 0) break;
+        f.size += n;
+        if (direct && (n & 511)) break;  // only the end of the file is not whole sectors, reading on from it fails
+      }
+      left -= f.size;
+
+      const bool last = f.err || f.size < chunk;
+      full_bufs.release();
+      if (last) return;
+    }
+  });
+
+  int err{};
+  for (ui64 i{};; i++) {
+    full_bufs.acquire();
+    auto& f = filled[i % depth];
+    stream.update((uint8_t*)pool + (i % depth) * chunk, f.size);
+    err = f.err;
+    const bool last = f.err || f.size < chunk;
+    free_bufs.release();
+    if (last) break;
+  }
+
+  reader.join();
+  free(pool);
+  return err;
+}
+
+static int hash_mmap(const int fd, const ui64 size, StreebogStream& stream, MmapConfig const& cfg) {
+  const off_t start = lseek(fd, 0, SEEK_CUR);
+  if (start < 0 || (ui64)start >= size) return hash_read(fd, stream);
+
+  const ui64 window = (cfg.window ? (cfg.window + MAP_ALIGN - 1) & ~(MAP_ALIGN - 1) : size);
+  const int flags = MAP_PRIVATE | (cfg.populate ? MAP_POPULATE : 0);
+  for (ui64 off = start; off < size;) {
+    const ui64 base = (cfg.window ? off & ~(MAP_ALIGN - 1) : 0);
+    const ui64 len = (size - base < window ? size - base : window);
+    auto m = (uint8_t*)mmap(nullptr, len, PROT_READ, flags, fd, base);
+    if (m == MAP_FAILED) {  // no address space for the window or a file system without mmap: read the rest
+      lseek(fd, off, SEEK_SET);
+      return hash_read(fd, stream);
+    }
+    if (cfg.sequential) madvise(m, len, MADV_SEQUENTIAL);
+    if (cfg.hugepage) madvise(m, len, MADV_HUGEPAGE);
+
+    for (ui64 pos = off - base; pos < len;) {
+      const ui64 step = pos & ~(DROP_STEP - 1);
+      const ui64 step_end = (len - step < DROP_STEP ? len : step + DROP_STEP);
+      stream.update(m + pos, step_end - pos);
+      if (cfg.drop) madvise(m + step, step_end - step, MADV_DONTNEED);
+      pos = step_end;
+    }
+    munmap(m, len);
+    off = base + len;
+  }
+
+  lseek(fd, size, SEEK_SET);
+  return 0;
+}
+
+/**
+ * @brief hashes a sparse file: holes found with SEEK_DATA/SEEK_HOLE are hashed as zero blocks without any I/O,
+ * only the data extents are read
+ */
+static int hash_sparse(const int fd, const ui64 size, StreebogStream& stream) {
+  const off_t start = lseek(fd, 0, SEEK_CUR);
+  if (start < 0) return hash_read(fd, stream);
+  void* buff;
+  if (posix_memalign(&buff, DIRECT_ALIGN, READ_SIZE)) return ENOMEM;
+
+  int err{};
+  for (ui64 pos = start; pos < size && !err;) {
+    off_t data = lseek(fd, pos, SEEK_DATA);
+    if (data < 0 && errno != ENXIO) {  // SEEK_DATA is not supported: read the rest
+      err = (lseek(fd, pos, SEEK_SET) < 0 ? errno : hash_read(fd, stream));
+      free(buff);
+      return err;
+    }
+    const ui64 data_at = (data < 0 || (ui64)data > size ? size : data);  // ENXIO - a hole up to the end
+    stream.update_zeros(data_at - pos);
+    pos = data_at;
+    if (pos == size) break;
+
+    const off_t hole = lseek(fd, pos, SEEK_HOLE);
+    const ui64 hole_at = (hole < 0 || (ui64)hole > size ? size : hole);
+    while (pos < hole_at) {
+      auto n = pread(fd, buff, (hole_at - pos < READ_SIZE ? hole_at - pos : READ_SIZE), pos);
+      if (n < 0 && errno == EINTR) continue;
+      if (n < 0) err = errno;
+      if (n <= 0) break;
+      stream.update(buff, n);
+      pos += n;
+    }
+    if (pos < hole_at) break;  // an error or the file has shrunk
+  }
+
+  free(buff);
+  lseek(fd, size, SEEK_SET);
+  return err;
+}
+
+/**
+ * @brief hashes a pipe: the pipe buffer is enlarged so the writer is not stopped every 64KB and reads return up to
+ * 1MB; with more than one CPU a reader thread gathers the reads into whole chunks while the previous one is hashed
+ */
+static int hash_pipe(const int fd, StreebogStream& stream) {
+  for (ui64 size = PIPE_SIZE; size > (1ULL << 16); size >>= 1)  // unprivileged users are limited by fs/pipe-max-size
+    if (fcntl(fd, F_SETPIPE_SZ, (int)size) >= 0) break;
+  // on one CPU the reader thread only takes time from the producer and the hashing
+  return (std::thread::hardware_concurrency() > 1 ? hash_pipelined(fd, stream, {3, READ_SIZE}) : hash_read(fd, stream));
+}
+
+static ui64 sysfs_number(char const* path) {
+  char buf[32]{};
+  const int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return 0;
+  const auto n = read(fd, buf, sizeof(buf) - 1);
+  close(fd);
+  return (n > 0 ? strtoull(buf, nullptr, 10) : 0);
+}
+
+/**
+ * @brief finds the O_DIRECT alignment and a good read size for the device a file lives on
+ * @details
+ * Reads queue/logical_block_size and queue/optimal_io_size of the block device (or of the disk a partition belongs
+ * to). Devices without a queue in sysfs (tmpfs, overlayfs, network file systems) get DIRECT_ALIGN and READ_SIZE.
+ */
+static void device_io_sizes(const dev_t dev, ui64& align, ui64& chunk) {
+  align = DIRECT_ALIGN, chunk = READ_SIZE;
+  char path[96];
+  ui64 lbs{}, opt{};
+  for (auto dir : {"queue", "../queue"}) {
+    snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/%s/logical_block_size", major(dev), minor(dev), dir);
+    if (!(lbs = sysfs_number(path))) continue;
+    snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/%s/optimal_io_size", major(dev), minor(dev), dir);
+    opt = sysfs_number(path);
+    break;
+  }
+
+  if (lbs && !(lbs & (lbs - 1))) align = lbs;
+  if (opt > chunk && opt <= MAX_DIRECT_CHUNK)
+    chunk = opt;
+  else if (opt)
+    chunk = (chunk + opt - 1) / opt * opt;  // whole stripes
+  chunk = (chunk + align - 1) & ~(align - 1);
+}
+
+namespace {
+  std::mutex uring_mtx;
+  std::vector<std::pair<UringReader::Config, std::unique_ptr<UringReader>>> idle_urings;  ///< least recent first
+
+  /**
+   * @brief io_uring reader for the duration of one call
+   * @details
+   * Takes an idle reader set up with the same config, or sets up a new one, and puts it back at the end. Setting up
+   * a ring and registering its buffers costs more than reading a small file, so it is not done for every file; at
+   * most IDLE_URINGS readers (the most recently used) stay allocated between calls, whatever the number of threads
+   * which ever used one.
+   */
+  struct UringLease {
+    UringReader::Config cfg;
+    std::unique_ptr<UringReader> reader;
+
+    explicit UringLease(UringReader::Config const& _cfg) : cfg{_cfg} {
+      {
+        std::lock_guard lk{uring_mtx};
+        for (auto it = idle_urings.rbegin(); it != idle_urings.rend(); it++)
+          if (it->first.depth == cfg.depth && it->first.chunk == cfg.chunk) {
+            reader = std::move(it->second);
+            idle_urings.erase(std::next(it).base());
+            break;
+          }
+      }
+      if (!reader) reader = std::make_unique<UringReader>(cfg);
+    }
+
+    ~UringLease() {
+      std::unique_ptr<UringReader> dropped;  // released after the lock
+      std::lock_guard lk{uring_mtx};
+      idle_urings.emplace_back(cfg, std::move(reader));
+      if (idle_urings.size() > IDLE_URINGS) {
+        dropped = std::move(idle_urings.front().second);
+        idle_urings.erase(idle_urings.begin());
+      }
+    }
+
+    UringReader* operator->() const { return reader.get(); }
+  };
+}  // namespace
+
+int hash_fd(const int fd, const Streebog::Mode mode, void* out, const ReadMethod method) {
+  struct stat st;
+  if (fstat(fd, &st)) return errno;
+
+  auto m = method;
+  if (!S_ISREG(st.st_mode) || !st.st_size)
+    m = ReadMethod::Read;
+  else if (m == ReadMethod::Auto)
+    m = ((ui64)st.st_size >= DIRECT_THRESHOLD ? ReadMethod::Direct : ReadMethod::Mmap);
+
+  const bool sparse = S_ISREG(st.st_mode) && (ui64)st.st_blocks * 512 < (ui64)st.st_size;  // less allocated than size
+  if (m == ReadMethod::Direct && !(sparse && method == ReadMethod::Auto)) return hash_fd_direct(fd, mode, out);
+  if (m == ReadMethod::Uring) return UringLease{{}}->hash_fd(fd, mode, out);
+
+  StreebogStream stream{mode};
+  int err{};
+  if (sparse && method == ReadMethod::Auto)
+    err = hash_sparse(fd, st.st_size, stream);
+  else if (m == ReadMethod::Mmap)
+    err = hash_mmap(fd, st.st_size, stream, {});
+  else if (method == ReadMethod::Auto && S_ISFIFO(st.st_mode))
+    err = hash_pipe(fd, stream);
+  else
+    err = hash_read(fd, stream);
+
+  if (!err) stream.finalize(out);
+  return err;
+}
+
+int hash_fd_pipelined(const int fd, const Streebog::Mode mode, void* out, PipelineConfig const& cfg) {
+  StreebogStream stream{mode};
+  auto err = hash_pipelined(fd, stream, cfg);
+  if (!err) stream.finalize(out);
+  return err;
+}
+
+void hash_fds(const ui64 count, int const* fd, const Streebog::Mode mode, void* const* out, int* err) {
+  UringLease{{}}->hash_fds(count, fd, mode, out, err);
+}
+
+int hash_fd_direct(const int fd, const Streebog::Mode mode, void* out, const uint64_t chunk) {
+  struct stat st;
+  if (fstat(fd, &st)) return errno;
+  const off_t off = lseek(fd, 0, SEEK_CUR);
+  if (!S_ISREG(st.st_mode) || off < 0 || (ui64)off >= (ui64)st.st_size) return hash_fd(fd, mode, out, ReadMethod::Read);
+
+  ui64 align, io_size;
+  device_io_sizes(st.st_dev, align, io_size);
+  if (chunk) io_size = (chunk + align - 1) & ~(align - 1);
+
+  // [off, body) and [tail, size) are read through the page cache, [body, tail) with O_DIRECT
+  const ui64 size = st.st_size;
+  const ui64 up = ((ui64)off + align - 1) & ~(align - 1);
+  const ui64 body = (up < size ? up : size);
+  const ui64 tail = ((size & ~(align - 1)) > body ? size & ~(align - 1) : body);
+
+  StreebogStream stream{mode};
+  int err{};
+  if (body > (ui64)off) {
+    uint8_t head[4096];
+    for (ui64 pos = off; pos < body;) {
+      const ui64 want = body - pos;
+      auto n = pread(fd, head, (want < sizeof(head) ? want : sizeof(head)), pos);
+      if (n < 0 && errno == EINTR) continue;
+      if (n < 0) err = errno;
+      if (n <= 0) break;
+      stream.update(head, n), pos += n;
+    }
+  }
+
+  if (!err && tail > body) {
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+    const int dfd = open(path, O_RDONLY | O_DIRECT | O_CLOEXEC);
+    if (dfd >= 0) {
+      UringLease uring{{16, io_size}};  // nothing reads ahead for O_DIRECT but us, so keep the queue busy
+      if (uring->available()) {
+        err = uring->update(dfd, body, tail - body, stream);
+      } else {
+        lseek(dfd, body, SEEK_SET);
+        err = hash_pipelined(dfd, stream, {3, io_size}, tail - body);
+      }
+      close(dfd);
+    }
+
+    if (dfd < 0 || err == EINVAL) {  // no O_DIRECT on this file system: start over through the page cache
+      stream.reset();
+      lseek(fd, off, SEEK_SET);
+      err = hash_pipelined(fd, stream, {3, io_size});
+      if (!err) stream.finalize(out);
+      return err;
+    }
+  }
+
+  if (!err) {
+    lseek(fd, tail, SEEK_SET);
+    err = hash_read(fd, stream);
+  }
+  if (!err) stream.finalize(out);
+  return err;
+}
+
+int hash_fd_mmap(const int fd, const Streebog::Mode mode, void* out, MmapConfig const& cfg) {
+  struct stat st;
+  if (fstat(fd, &st)) return errno;
+
+  StreebogStream stream{mode};
+  auto err = (S_ISREG(st.st_mode) && st.st_size ? hash_mmap(fd, st.st_size, stream, cfg) : hash_read(fd, stream));
+  if (!err) stream.finalize(out);
+  return err;
+}
+
+int hash_copy(const int fd, const int dest, const Streebog::Mode mode, void* out, PipelineConfig const& cfg) {
+  const ui64 depth = (cfg.depth < 2 ? 2 : cfg.depth);
+  const ui64 chunk = (cfg.chunk + DIRECT_ALIGN - 1) & ~(DIRECT_ALIGN - 1);
+  void* pool;
+  if (posix_memalign(&pool, DIRECT_ALIGN, depth * chunk)) return ENOMEM;
+
+  std::vector<ui64> filled(depth);  ///< 0 - end of data
+  std::counting_semaphore<> free_bufs(depth), full_bufs(0);
+  std::atomic<int> write_err{};
+
+  std::thread writer([&] {
+    for (ui64 i{};; i++) {
+      full_bufs.acquire();
+      const ui64 size = filled[i % depth];
+      auto buff = (uint8_t*)pool + (i % depth) * chunk;
+      for (ui64 done{}; done < size && !write_err;) {
+        auto n = write(dest, buff + done, size - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) write_err = errno;
+        if (n > 0) done += n;
+      }
+      free_bufs.release();
+      if (!size) return;
+    }
+  });
+
+  StreebogStream stream{mode};
+  int err{};
+  for (ui64 i{};; i++) {
+    free_bufs.acquire();
+    auto buff = (uint8_t*)pool + (i % depth) * chunk;
+    ssize_t n;
+    while ((n = read(fd, buff, chunk)) < 0 && errno == EINTR) {
+    }
+    if (n < 0) err = errno;
+
+    const bool last = n <= 0 || write_err;
+    filled[i % depth] = (last ? 0 : n);
+    full_bufs.release();
+    if (last) break;
+    stream.update(buff, n);  // the writer only reads the buffer too, it is not reused before the next acquire()
+  }
+
+  writer.join();
+  free(pool);
+  if (!err) err = write_err;
+  if (!err) stream.finalize(out);
+  return err;
+}
+
+namespace {
+  /**
+   * @brief a part of a buffer for one segment hasher; a piece with end set completes its segment
+   */
+  struct Piece {
+    uint8_t const* data;
+    ui64 size, buf;
+    bool end;
+  };
+
+  /**
+   * @brief hasher of every threads-th segment: its pieces come in data order, so one context is enough
+   */
+  struct SegmentHasher {
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<Piece> todo;
+    bool closed{};
+    std::vector<uint8_t> digests;  ///< of its segments, in order
+
+    void push(Piece const& p) {
+      std::lock_guard lk{mtx};
+      todo.push_back(p);
+      cv.notify_one();
+    }
+
+    void close() {
+      std::lock_guard lk{mtx};
+      closed = true;
+      cv.notify_one();
+    }
+
+    template <typename Release>
+    void run(const Streebog::Mode mode, Release const& release) {
+      StreebogStream part{mode};
+      const ui64 d = Streebog::digest_size(mode);
+      for (;;) {
+        Piece p;
+        {
+          std::unique_lock lk{mtx};
+          cv.wait(lk, [&] { return !todo.empty() || closed; });
+          if (todo.empty()) return;
+          p = todo.front();
+          todo.pop_front();
+        }
+        if (p.size) part.update(p.data, p.size), release(p.buf);
+        if (p.end) digests.resize(digests.size() + d), part.finalize(digests.data() + digests.size() - d), part.reset();
+      }
+    }
+  };
+}  // namespace
+
+int hash_fd_segments(const int fd, const Streebog::Mode mode, void* out, const uint64_t segment,
+                     std::vector<uint8_t>& segments, PipelineConfig const& cfg, const unsigned threads) {
+  if (!segment) return EINVAL;
+  const ui64 depth = (cfg.depth < 2 ? 2 : cfg.depth);
+  const ui64 chunk = (cfg.chunk + DIRECT_ALIGN - 1) & ~(DIRECT_ALIGN - 1);
+  const ui64 seg = segment, d = Streebog::digest_size(mode);
+  void* pool;
+  if (posix_memalign(&pool, DIRECT_ALIGN, depth * chunk)) return ENOMEM;
+
+  // more hashers than segments spanned by the buffers in flight would never have anything to do
+  ui64 count = (threads ? threads : std::thread::hardware_concurrency());
+  count = std::max<ui64>(1, std::min(count, (depth * chunk + seg - 1) / seg + 1));
+
+  // a buffer goes back to the free list once the whole-data hash and every segment it is cut into are done with it
+  std::vector<std::atomic<ui64>> users(depth);
+  std::counting_semaphore<> free_bufs(depth);
+  auto release = [&](const ui64 b) {
+    if (users[b].fetch_sub(1) == 1) free_bufs.release();
+  };
+
+  std::vector<SegmentHasher> hashers(count);
+  std::vector<std::thread> workers;
+  for (auto& h : hashers) workers.emplace_back([&] { h.run(mode, release); });
+
+  StreebogStream stream{mode};
+  int err{};
+  ui64 pos{};
+  for (ui64 i{};; i++) {
+    free_bufs.acquire();
+    const ui64 b = i % depth;
+    auto buff = (uint8_t*)pool + b * chunk;
+    ssize_t n;
+    while ((n = read(fd, buff, chunk)) < 0 && errno == EINTR) {
+    }
+    if (n < 0) err = errno;
+    if (n <= 0) {
+      if (pos % seg) hashers[pos / seg % count].push({nullptr, 0, 0, true});  // the last segment is short
+      break;
+    }
+
+    // the buffer is cut at segment boundaries, so the chunk size need not divide the segment size
+    const ui64 first = pos / seg, last = (pos + n - 1) / seg;
+    users[b] = 1 + (last - first + 1);
+    for (ui64 k = first, done{}; k <= last; k++) {
+      const ui64 end = std::min((k + 1) * seg, pos + n) - pos;
+      hashers[k % count].push({buff + done, end - done, b, pos + end == (k + 1) * seg});
+      done = end;
+    }
+    stream.update(buff, n);
+    pos += n;
+    release(b);
+  }
+
+  for (auto& h : hashers) h.close();
+  for (auto& w : workers) w.join();
+  free(pool);
+  segments.clear();
+  if (err) return err;
+
+  const ui64 total = (pos + seg - 1) / seg;
+  segments.resize(total * d);
+  for (ui64 k{}; k < total; k++) memcpy(segments.data() + k * d, hashers[k % count].digests.data() + k / count * d, d);
+  stream.finalize(out);
+  return 0;
+}
+
+int hash_fd_checkpointed(const int fd, const Streebog::Mode mode, void* out, const uint64_t interval, Checkpoint* cp) {
+  struct stat st;
+  if (fstat(fd, &st)) return errno;
+  if (!S_ISREG(st.st_mode)) return EINVAL;
+
+  const ui64 step = (interval ? (interval + 63) & ~63ULL : READ_SIZE);
+  void* buff;
+  if (posix_memalign(&buff, DIRECT_ALIGN, READ_SIZE)) return ENOMEM;
+
+  StreebogStream stream{mode};
+  Checkpoint &prev = cp[0], &last = cp[1];
+  // feeds [pos, to) or up to the end of the file, recording a checkpoint at every multiple of step if mark is set
+  auto hash_range = [&](ui64& pos, const ui64 to, const bool mark) {
+    while (pos < to) {
+      const ui64 room = (step - pos % step < READ_SIZE ? step - pos % step : READ_SIZE);  // never across a checkpoint
+      auto n = pread(fd, buff, (to - pos < room ? to - pos : room), pos);
+      if (n < 0 && errno == EINTR) continue;
+      if (n < 0) return errno;
+      if (!n) break;
+      stream.update(buff, n);
+      pos += n;
+      if (mark && !(pos % step)) prev = last, last = {pos, stream.midstate()};
+    }
+    return 0;
+  };
+
+  int err{};
+  ui64 pos{};
+  if (last.offset && !(last.offset % step) && last.offset - prev.offset == step && last.offset <= (ui64)st.st_size) {
+    if (prev.offset) stream.resume(prev.state);  // the checkpoint at 0 is the IV whatever has been saved
+    pos = prev.offset;
+    err = hash_range(pos, last.offset, false);
+    auto m = stream.midstate();
+    if (err || pos != last.offset || memcmp(&m, &last.state, sizeof(m))) pos = 0;  // the last region has changed
+  }
+
+  if (!err && !pos) {
+    stream.reset();
+    prev = last = {0, stream.midstate()};
+  }
+  if (!err) err = hash_range(pos, ~0ULL, true);
+
+  free(buff);
+  if (!err) stream.finalize(out);
+  return err;
+}
+
+int hash_file(const char* path, const Streebog::Mode mode, void* out, const ReadMethod method) {
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0) return errno;
+
+  auto err = hash_fd(fd, mode, out, method);
+  close(fd);
+  return err;
+}
+
+void digest_to_hex(void const* digest, const Streebog::Mode mode, char* hex) {
+  static constexpr char digits[] = "0123456789abcdef";
+  const ui64 n = Streebog::digest_size(mode);
+  for (ui64 i{}; i < n; i++) {
+    const uint8_t b = ((uint8_t const*)digest)[n - 1 - i];
+    hex[i << 1] = digits[b >> 4], hex[(i << 1) | 1] = digits[b & 0xF];
+  }
+  hex[n << 1] = '\0';
+}
+
+#if defined(__SSSE3__)
+/**
+ * @brief decodes 32 hex chars into 16 bytes stored in reverse order
+ */
+static inline bool hex32_to_bytes(char const* hex, uint8_t* out) {
+  auto nibbles = [](const __m128i v, __m128i& valid) {
+    const __m128i digit = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+    const __m128i alpha = _mm_sub_epi8(_mm_or_si128(v, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    const __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+    const __m128i is_alpha = _mm_cmpeq_epi8(_mm_min_epu8(alpha, _mm_set1_epi8(5)), alpha);
+    valid = _mm_and_si128(valid, _mm_or_si128(is_digit, is_alpha));
+    const __m128i nib = _mm_or_si128(_mm_and_si128(is_digit, digit),
+                                     _mm_and_si128(is_alpha, _mm_add_epi8(alpha, _mm_set1_epi8(10))));
+    return _mm_maddubs_epi16(nib, _mm_set1_epi16(0x0110));  // hi * 16 + lo for every pair
+  };
+
+  __m128i valid = _mm_set1_epi8(-1);
+  const __m128i lo = nibbles(_mm_loadu_si128((__m128i const*)hex), valid);
+  const __m128i hi = nibbles(_mm_loadu_si128((__m128i const*)(hex + 16)), valid);
+  const __m128i rev = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+  _mm_storeu_si128((__m128i*)out, _mm_shuffle_epi8(_mm_packus_epi16(lo, hi), rev));
+
+  return _mm_movemask_epi8(valid) == 0xFFFF;
+}
+#endif
+
+bool hex_to_digest(char const* hex, const Streebog::Mode mode, void* digest) {
+  const ui64 n = Streebog::digest_size(mode);
+#if defined(__SSSE3__)
+  bool ok = true;
+  for (ui64 i{}; i < n; i += 16) ok &= hex32_to_bytes(hex + (i << 1), (uint8_t*)digest + n - 16 - i);
+  return ok;
+#else
+  auto nibble = [](const char c) -> int {
+    if (c >= '0' && c <= '9') return c - '0';
+    if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') return (c | 0x20) - 'a' + 10;
+    return -1;
+  };
+
+  for (ui64 i{}; i < n; i++) {
+    const int hi = nibble(hex[i << 1]), lo = nibble(hex[(i << 1) | 1]);
+    if (hi < 0 || lo < 0) return false;
+    ((uint8_t*)digest)[n - 1 - i] = (uint8_t)(hi << 4 | lo);
+  }
+
+  return true;
+#endif
+}
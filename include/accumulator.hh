@@ -0,0 +1,118 @@
+/**
+ * @file    accumulator.hh
+ * @brief   Append-only Merkle accumulator of a transparency log (RFC 6962 / RFC 9162 layout) with Streebog-256
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#pragma once
+#include <stdint.h>
+
+#include <vector>
+
+#include "streebog.hh"
+
+/**
+ * @brief Merkle tree of a log that only grows, with inclusion and consistency proofs
+ * @details
+ * The tree is the one of RFC 6962, section 2.1, with Streebog-256 as HASH: a leaf is H(0x00 || entry), a node is
+ * H(0x01 || left || right), a tree of n entries is split into the largest power of two k < n entries on the left
+ * and the rest on the right, and the tree of no entries is H() of the empty string. Proofs have the format and the
+ * verification algorithms of RFC 9162, sections 2.1.3 and 2.1.4: 32-byte hashes, from the leaf up.
+ *
+ * The roots of all complete subtrees are kept in one array in in-order layout (leaf i at 2i, the subtree of 2^l
+ * entries starting at entry i << l at (i << (l + 1)) + 2^l - 1), about 64 bytes per entry; the roots of the
+ * incomplete subtrees on the right edge of the current tree are cached after every append. So proofs against the
+ * current tree size copy O(log n) stored hashes and hash nothing; a proof against an earlier size first computes the
+ * right edge of that size from the stored roots (fewer than log n hashes, once per proof) and then copies as well.
+ * Entries themselves are not kept.
+ */
+class MerkleAccumulator {
+ public:
+  static constexpr uint64_t HASH_SIZE = 32;
+
+  /**
+   * @brief appends entries; their leaves and the new complete subtrees of every level are hashed in one
+   * streebog_batch() call per level
+   * @param count number of entries
+   * @param entries pointers to the entries
+   * @param sizes their sizes in bytes
+   */
+  void append(const uint64_t count, void const* const* entries, uint64_t const* sizes);
+  void append(void const* entry, const uint64_t size) { append(1, &entry, &size); }
+
+  void reserve(const uint64_t entries) { nodes.reserve(2 * entries * HASH_SIZE); }  ///< avoids reallocations
+  uint64_t size() const { return count; }
+
+  /**
+   * @brief writes the root of the tree of the first n entries
+   * @return 0, EINVAL if n is more than size()
+   */
+  int root(const uint64_t n, void* out) const;
+  void root(void* out) const { root(count, out); }  ///< root of the current tree
+
+  /**
+   * @brief writes the hash of entry i
+   * @return 0, EINVAL if there is no such entry
+   */
+  int leaf(const uint64_t i, void* out) const;
+
+  /**
+   * @brief collects the inclusion proof of entry i in the tree of the first n entries
+   * @return 0, EINVAL unless i < n <= size()
+   */
+  int prove_inclusion(const uint64_t i, const uint64_t n, std::vector<uint8_t>& proof) const;
+
+  /**
+   * @brief collects the proof that the tree of the first m entries is a prefix of the tree of the first n ones
+   * @return 0, EINVAL unless 0 < m <= n <= size(); the proof is empty for m == n
+   */
+  int prove_consistency(const uint64_t m, const uint64_t n, std::vector<uint8_t>& proof) const;
+
+  static void leaf_hash(void const* entry, const uint64_t size, void* out);  ///< H(0x00 || entry)
+
+  /**
+   * @brief checks an inclusion proof
+   * @param leaf hash of the entry, see leaf_hash()
+   * @param i index of the entry
+   * @param n tree size the proof was made for
+   * @param root root of that tree
+   * @param proof the proof
+   * @param proof_size its size in bytes
+   */
+  static bool verify_inclusion(void const* leaf, const uint64_t i, const uint64_t n, void const* root,
+                               void const* proof, const uint64_t proof_size);
+
+  /**
+   * @brief checks a consistency proof between the trees of m and n entries, m <= n
+   */
+  static bool verify_consistency(const uint64_t m, const uint64_t n, void const* old_root, void const* new_root,
+                                 void const* proof, const uint64_t proof_size);
+
+ private:
+  static uint64_t slot(const uint64_t first, const uint64_t width);  ///< index of a complete subtree in nodes
+  uint8_t const* subtree(const uint64_t first, const uint64_t width) const {
+    return nodes.data() + slot(first, width) * HASH_SIZE;
+  }
+
+  /**
+   * @brief roots of the incomplete subtrees on the right edge of a tree
+   */
+  struct Edge {
+    std::vector<uint64_t> first;  ///< their first entries, largest subtree first
+    std::vector<uint8_t> roots;
+  };
+  void right_edge(const uint64_t n, Edge& e) const;        ///< computes the edge of the tree of n entries
+  Edge const& edge_of(const uint64_t n, Edge& tmp) const;  ///< the cached edge of n, or the one computed into tmp
+
+  /**
+   * @brief root of entries [lo, hi), a node of the tree of hi entries whose edge is e
+   */
+  void range_root(const uint64_t lo, const uint64_t hi, Edge const& e, uint8_t* out) const;
+
+  uint64_t count{};
+  std::vector<uint8_t> nodes;  ///< roots of the complete subtrees, in-order
+  Edge edge;                   ///< of the current tree
+};
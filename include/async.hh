@@ -0,0 +1,116 @@
+/**
+ * @file    async.hh
+ * @brief   C++20 coroutine interface for Streebog hashing
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#pragma once
+#include <stdint.h>
+
+#include <concepts>
+#include <coroutine>
+#include <functional>
+#include <span>
+
+#include "streebog.hh"
+
+/**
+ * @brief anything work can be scheduled on: an event loop, a strand, a thread pool
+ * @details the only requirement is post() accepting a nullary callable which is run later on some thread
+ */
+template <typename E>
+concept StreebogExecutor = requires(E& ex, std::function<void()> f) { ex.post(std::move(f)); };
+
+/**
+ * @brief Streebog context with awaitable update
+ * @details
+ * co_await update_async() hashes the data in bounded slices, posting every slice to an executor as a separate
+ * job. Posting to the event loop itself interleaves hashing with other work of the loop, which never blocks for
+ * longer than one slice. Posting to a worker pool moves the G work off the loop completely; the coroutine is then
+ * resumed through the home executor given.
+ * @warning the data must stay valid and the object must not be used by anyone else until the co_await completes
+ */
+class AsyncStreebog {
+  StreebogStream stream;
+
+  template <StreebogExecutor Work, StreebogExecutor Home>
+  struct UpdateAwaiter {
+    StreebogStream& stream;
+    uint8_t const* m;
+    uint64_t left;
+    uint64_t slice;
+    Work& work;
+    Home& home;
+
+    bool await_ready() const noexcept { return left == 0; }
+    void await_suspend(std::coroutine_handle<> h) { step(h); }
+    void await_resume() const noexcept {}
+
+    void step(std::coroutine_handle<> h) {
+      work.post([this, h] {
+        auto n = (left < slice ? left : slice);
+        stream.update(m, n);
+        m += n, left -= n;
+        if (left)
+          step(h);
+        else if constexpr (std::same_as<Work, Home>)
+          (&work == &home) ? h.resume() : home.post([h] { h.resume(); });
+        else
+          home.post([h] { h.resume(); });
+      });
+    }
+  };
+
+  /**
+   * @brief rounds a slice up to a whole number of blocks, at least one; the largest sizes are rounded down instead
+   * of wrapping to 0, which would make the awaiter post itself forever
+   */
+  static constexpr uint64_t whole_blocks(const uint64_t slice) {
+    return (slice < 64 ? 64 : (slice > ~0x3FULL ? ~0x3FULL : (slice + 63) & ~0x3FULL));
+  }
+
+ public:
+  static constexpr uint64_t DEFAULT_SLICE = 1ULL << 18;  ///< 256KB, about a millisecond of G work
+
+  explicit AsyncStreebog(const Streebog::Mode _mode) : stream{_mode} {}
+
+  Streebog::Mode mode() const { return stream.mode(); }
+  void reset() { stream.reset(); }
+
+  /**
+   * @brief hashes the data in slices on the given executor, the coroutine is resumed on it as well
+   * @param m input data
+   * @param ex executor running the slices
+   * @param slice max number of bytes processed by one job (rounded up to a whole block, 0 - one block)
+   */
+  template <StreebogExecutor E>
+  auto update_async(std::span<uint8_t const> m, E& ex, const uint64_t slice = DEFAULT_SLICE) {
+    return UpdateAwaiter<E, E>{stream, m.data(), m.size(), whole_blocks(slice), ex, ex};
+  }
+
+  /**
+   * @brief hashes the data in slices on the worker executor and resumes the coroutine on the home executor
+   * @param m input data
+   * @param work executor running the slices (usually a thread pool)
+   * @param home executor the coroutine continues on (usually the event loop)
+   * @param slice max number of bytes processed by one job (rounded up to a whole block, 0 - one block)
+   */
+  template <StreebogExecutor Work, StreebogExecutor Home>
+  auto update_async(std::span<uint8_t const> m, Work& work, Home& home, const uint64_t slice = DEFAULT_SLICE) {
+    return UpdateAwaiter<Work, Home>{stream, m.data(), m.size(), whole_blocks(slice), work, home};
+  }
+
+  /**
+   * @brief synchronous update, for small chunks which are not worth a trip through an executor
+   */
+  void update(void const* m, const uint64_t size) { stream.update(m, size); }
+
+  /**
+   * @brief completes the hash calculation; it costs at most three G calls, so it is not made awaitable
+   * @param out array of Streebog::digest_size() bytes for writing output
+   */
+  void finalize(void* out) { stream.finalize(out); }
+};
@@ -0,0 +1,87 @@
+/**
+ * @file    delta.hh
+ * @brief   rsync-style signatures and deltas of files with Streebog-256 as the strong hash
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#pragma once
+#include <stdint.h>
+
+#include <vector>
+
+#include "streebog.hh"
+
+/**
+ * @brief block sums of a basis file, enough to describe another file in terms of it
+ * @details
+ * Every block of the basis gets a rolling weak sum (the one of rsync) and the first strong_len bytes of its
+ * Streebog-256. The last block may be shorter than the others.
+ */
+struct Signature {
+  uint32_t block;               ///< block size in bytes
+  uint32_t strong_len;          ///< bytes of Streebog-256 kept per block, 1 to 32
+  uint64_t size;                ///< size of the basis
+  std::vector<uint32_t> weak;   ///< weak sum of every block
+  std::vector<uint8_t> strong;  ///< strong_len bytes of every block
+};
+
+/**
+ * @brief what make_delta() has found
+ */
+struct DeltaStats {
+  uint64_t copied;   ///< bytes taken from the basis
+  uint64_t literal;  ///< bytes written into the delta
+};
+
+/**
+ * @brief reads a basis file and calculates its signature
+ * @details the strong hashes of the blocks are calculated by the multi-lane kernel (see streebog_batch())
+ * @param fd file descriptor, read from its current offset up to the end; it is not closed
+ * @param block block size, rounded up to 64 bytes; 0 - the power of two next to the square root of the file size,
+ * 1KB to 64KB
+ * @param strong_len bytes of Streebog-256 kept per block, 0 - 16
+ * @param sig receives the signature
+ * @return 0 or errno value, EINVAL for strong_len above 32
+ */
+int make_signature(const int fd, const uint32_t block, const uint32_t strong_len, Signature& sig);
+
+/**
+ * @brief writes a signature in the portable (little-endian) format read by read_signature()
+ * @return 0 or errno value
+ */
+int write_signature(const int fd, Signature const& sig);
+
+/**
+ * @brief reads a signature written by write_signature()
+ * @return 0 or errno value, EBADMSG if the data is not a valid signature
+ */
+int read_signature(const int fd, Signature& sig);
+
+/**
+ * @brief describes a new file as blocks of the basis and literal data
+ * @details
+ * The new file is read once with a rolling weak sum. Where the weak sum of a window matches a block of the basis,
+ * the window and the windows one block, two blocks and so on after it whose weak sums match the blocks following
+ * that block are hashed together by the multi-lane kernel, so an unchanged run of blocks costs one batched strong
+ * hash per several blocks. The delta ends with the size and the Streebog-256 of the new file, which apply_delta()
+ * checks.
+ * @param sig signature of the basis
+ * @param fd new file descriptor, read from its current offset up to the end; may be a pipe; it is not closed
+ * @param out delta file descriptor, written sequentially; it is not closed
+ * @param stats receives the number of copied and literal bytes, may be nullptr
+ * @return 0 or errno value
+ */
+int make_delta(Signature const& sig, const int fd, const int out, DeltaStats* stats = nullptr);
+
+/**
+ * @brief rebuilds the new file from the basis and a delta made by make_delta()
+ * @param basis basis file descriptor, read with pread(); it is not closed
+ * @param delta delta file descriptor, read sequentially; it is not closed
+ * @param out file descriptor the new file is written to sequentially; it is not closed
+ * @return 0 or errno value, EBADMSG if the delta is malformed or the result does not hash to the digest of the new
+ * file (the basis is not the file the signature was made of)
+ */
+int apply_delta(const int basis, const int delta, const int out);
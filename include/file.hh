@@ -0,0 +1,210 @@
+/**
+ * @file    file.hh
+ * @brief   Hashing of files and file descriptors
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#pragma once
+#include <stdint.h>
+
+#include <vector>
+
+#include "streebog.hh"
+
+/**
+ * @brief the way file data gets into the context
+ */
+enum class ReadMethod {
+  Auto,    ///< chosen per file, see hash_fd()
+  Read,    ///< read() into a buffer; works for anything, including pipes and terminals
+  Mmap,    ///< map the file and hash the pages in place (see hash_fd_mmap()); the fastest way for cached files
+  Direct,  ///< O_DIRECT reads bypassing the page cache (see hash_fd_direct()); for huge files not cached anyway
+  Uring,   ///< buffered reads kept in flight by io_uring (see UringReader), readers are reused between calls
+  __COUNT__
+};
+
+/**
+ * @brief files at least this large are read with O_DIRECT in ReadMethod::Auto mode
+ */
+constexpr uint64_t DIRECT_THRESHOLD = 1ULL << 30;
+
+/**
+ * @brief calculates the hash of the data from the current offset of fd up to its end
+ * @param fd file descriptor, it is not closed
+ * @param mode operating mode
+ * @param out array of Streebog::digest_size() bytes for writing output
+ * @param method read method; Auto uses Mmap for regular files, Direct for regular files of DIRECT_THRESHOLD bytes
+ * and more, and Read for everything else; pipes get a 1MB buffer (F_SETPIPE_SZ) and, on machines with more than one
+ * CPU, are read by a separate thread in 1MB batches; in sparse files only the data found with SEEK_DATA/SEEK_HOLE is
+ * read, holes are hashed as zero blocks (see Streebog::update_zeros())
+ * @return 0 or errno value
+ * @note Mmap, Direct and Uring silently fall back to Read where the file does not support them
+ */
+int hash_fd(const int fd, const Streebog::Mode mode, void* out, const ReadMethod method = ReadMethod::Auto);
+
+/**
+ * @brief calculates the hashes of several files at once through one io_uring reader, which keeps reads of all of
+ * them in flight (see UringReader::hash_fds()); the reader is reused between calls like the one of ReadMethod::Uring
+ * @param count number of files
+ * @param fd file descriptors, they are hashed from their current offsets and not closed
+ * @param mode operating mode for every file
+ * @param out arrays of Streebog::digest_size() bytes for writing output, one per file
+ * @param err receives 0 or errno value for every file
+ */
+void hash_fds(const uint64_t count, int const* fd, const Streebog::Mode mode, void* const* out, int* err);
+
+/**
+ * @brief settings of hash_fd_pipelined()
+ */
+struct PipelineConfig {
+  uint64_t depth = 3;          ///< number of buffers (2 - double buffering, 3 - triple buffering, ...)
+  uint64_t chunk = 1ULL << 20;  ///< size of a buffer, rounded up to 4KB
+};
+
+/**
+ * @brief calculates the hash of the data from the current offset of fd up to its end, reading and hashing in
+ * parallel
+ * @details
+ * A reader thread fills aligned buffers taken from a free list while the calling thread hashes the filled ones
+ * in order, so the time is max(I/O, G) rather than their sum. The buffers are 4KB aligned, so fd may be opened
+ * with O_DIRECT; then its current offset must be a multiple of the logical block size (the end of the file need not
+ * be).
+ * @param fd file descriptor, it is not closed
+ * @param mode operating mode
+ * @param out array of Streebog::digest_size() bytes for writing output
+ * @param cfg number and size of buffers
+ * @return 0 or errno value
+ */
+int hash_fd_pipelined(const int fd, const Streebog::Mode mode, void* out, PipelineConfig const& cfg = {});
+
+/**
+ * @brief copies the data from the current offset of fd up to its end into dest, calculating its hash on the way
+ * @details
+ * Every buffer is read once: the calling thread reads and hashes while a writer thread writes the previous buffers
+ * to dest, so the copy costs about max(read + G, write) rather than a copy followed by a second reading for the hash.
+ * @param fd source file descriptor, it is not closed
+ * @param dest destination file descriptor, written from its current offset; it is neither synced nor closed
+ * @param mode operating mode
+ * @param out array of Streebog::digest_size() bytes for writing output
+ * @param cfg number and size of buffers
+ * @return 0 or errno value of the first failed read or write; the hash is written only on success
+ */
+int hash_copy(const int fd, const int dest, const Streebog::Mode mode, void* out, PipelineConfig const& cfg = {});
+
+/**
+ * @brief calculates the hash of the data from the current offset of fd up to its end and the hashes of its segments
+ * @details
+ * Segment i is bytes [i * segment, (i + 1) * segment) of the data, the last one may be shorter; each segment hash is
+ * the standard hash of those bytes, so a receiver can check any segment on its own. The data is read once: the
+ * calling thread reads and computes the hash of the whole data, which stays sequential, while a pool of threads
+ * computes the segment hashes of the same buffers, segment i on thread i % threads; a buffer is reused once all of
+ * them are done with it. As many segments are hashed at once as the buffers in flight span, so with segments larger
+ * than depth * chunk the pool works like a single thread. Works for pipes too.
+ * @param fd file descriptor, it is not closed
+ * @param mode operating mode
+ * @param out array of Streebog::digest_size() bytes for writing the hash of the whole data
+ * @param segment segment size
+ * @param segments receives Streebog::digest_size() bytes per segment in data order, none for empty data
+ * @param cfg number and size of buffers
+ * @param threads segment hashing threads, 0 - one per hardware thread; no more are started than segments the
+ * buffers span
+ * @return 0 or errno value, EINVAL for a zero segment size
+ */
+int hash_fd_segments(const int fd, const Streebog::Mode mode, void* out, const uint64_t segment,
+                     std::vector<uint8_t>& segments, PipelineConfig const& cfg = {}, const unsigned threads = 0);
+
+/**
+ * @brief calculates the hash of the data from the current offset of fd up to its end, bypassing the page cache
+ * @details
+ * The part of the file between the first and the last logical block boundary is read with O_DIRECT (through
+ * io_uring when it is available, otherwise by a reader thread as in hash_fd_pipelined()); the unaligned head and
+ * tail are read through the page cache, so no O_DIRECT read is ever short or unaligned. fd itself may be opened
+ * without O_DIRECT. If the file system does not support O_DIRECT, the whole file is read through the page cache.
+ * @param fd file descriptor, it is not closed
+ * @param mode operating mode
+ * @param out array of Streebog::digest_size() bytes for writing output
+ * @param chunk size of one read, rounded up to the logical block size; 0 - optimal I/O size of the device, at least
+ * 1MB
+ * @return 0 or errno value
+ */
+int hash_fd_direct(const int fd, const Streebog::Mode mode, void* out, const uint64_t chunk = 0);
+
+/**
+ * @brief settings of hash_fd_mmap()
+ */
+struct MmapConfig {
+  uint64_t window = 1ULL << 26;  ///< size of one mapping, rounded up to 2MB; 0 - map the whole file at once
+  bool sequential = true;        ///< MADV_SEQUENTIAL: aggressive read-ahead
+  bool hugepage = false;         ///< MADV_HUGEPAGE: transparent huge pages where the file system supports them
+  bool populate = false;         ///< MAP_POPULATE: fault a window in completely when it is mapped
+  bool drop = true;              ///< MADV_DONTNEED on the hashed parts of a window, keeps the resident set small
+};
+
+/**
+ * @brief calculates the hash of the data from the current offset of fd up to its end, mapping the file in windows
+ * @details
+ * Only one window of the file is mapped at a time, so any file can be hashed with a small address space (32-bit
+ * builds, strict overcommit). Non-regular and empty files, and files that cannot be mapped, are read with read().
+ * @param fd file descriptor, it is not closed
+ * @param mode operating mode
+ * @param out array of Streebog::digest_size() bytes for writing output
+ * @param cfg window size and mapping hints
+ * @return 0 or errno value
+ * @warning as with any mapping, truncating the file while it is hashed kills the process with SIGBUS
+ */
+int hash_fd_mmap(const int fd, const Streebog::Mode mode, void* out, MmapConfig const& cfg = {});
+
+/**
+ * @brief a point of a file where hashing can be resumed
+ */
+struct Checkpoint {
+  uint64_t offset;           ///< number of bytes hashed, a multiple of the checkpoint interval
+  Streebog::Midstate state;  ///< context state after offset bytes
+};
+
+/**
+ * @brief calculates the hash of a file that only grows, continuing from the checkpoints of the previous run
+ * @details
+ * cp holds the last two checkpoints of the previous run, interval bytes apart. If the region between them still
+ * hashes from the first to the second, the data before the last checkpoint is taken as unchanged and only the rest
+ * of the file is read; otherwise the file is hashed from the start. Either way cp receives the last two checkpoints
+ * of the file as it is now. Only the last region is verified, so a change in front of it is not noticed: this is
+ * meant for append-only files (logs, WAL).
+ * @param fd file descriptor of a regular file; it is hashed from offset 0, the file offset is not used
+ * @param mode operating mode
+ * @param out array of Streebog::digest_size() bytes for writing output
+ * @param interval distance between checkpoints, rounded up to 64 bytes; 0 - 1MB
+ * @param cp in/out array of two checkpoints; zero-initialized for a file seen the first time
+ * @return 0 or errno value
+ */
+int hash_fd_checkpointed(const int fd, const Streebog::Mode mode, void* out, const uint64_t interval, Checkpoint* cp);
+
+/**
+ * @brief opens the file and calculates its hash
+ * @param path file path
+ * @param mode operating mode
+ * @param out array of Streebog::digest_size() bytes for writing output
+ * @param method read method, see hash_fd()
+ * @return 0 or errno value
+ */
+int hash_file(const char* path, const Streebog::Mode mode, void* out, const ReadMethod method = ReadMethod::Auto);
+
+/**
+ * @brief writes a hash as a hex string, most significant byte first (as printed by the control examples)
+ * @param digest hash in the layout of Streebog::operator()
+ * @param mode operating mode the hash was calculated in
+ * @param hex array of 2 * Streebog::digest_size() + 1 chars, receives a null-terminated string
+ */
+void digest_to_hex(void const* digest, const Streebog::Mode mode, char* hex);
+
+/**
+ * @brief parses a hex string written by digest_to_hex()
+ * @param hex hex string, upper or lower case, exactly 2 * Streebog::digest_size() chars are read
+ * @param mode operating mode the hash was calculated in
+ * @param digest array of Streebog::digest_size() bytes for writing output
+ * @return false if a char is not a hex digit
+ */
+bool hex_to_digest(char const* hex, const Streebog::Mode mode, void* digest);
@@ -0,0 +1,87 @@
+/**
+ * @file    ingest.hh
+ * @brief   Ordered multi-producer ingestion into a single Streebog hash chain
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#pragma once
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+
+#include "streebog.hh"
+
+/**
+ * @brief lock-free MPSC queue in front of a single hashing thread
+ * @details
+ * Producers publish sequence-numbered records (pointer + size, no copying) from any thread and in any order.
+ * The hashing thread consumes them strictly by sequence number, so the resulting digest covers the records as
+ * if they were concatenated in sequence order. Records are kept in a ring of capacity slots: record seq always
+ * goes to slot seq % capacity, so producers never contend with each other and only wait when they run more than
+ * capacity records ahead of the hashing thread.
+ * @warning a published buffer must stay valid until it is released (see Config::on_release and consumed())
+ */
+class OrderedIngest {
+  struct alignas(64) Slot {
+    std::atomic<uint64_t> tag;  ///< 2 * seq - free for record seq, 2 * seq + 1 - holds record seq
+    void const* data;
+    uint64_t size;
+  };
+
+ public:
+  struct Config {
+    uint64_t capacity = 1024;  ///< ring size, rounded up to a power of two
+    uint64_t batch = 64;       ///< max number of records hashed between two releases
+    /// called by the hashing thread once a record was hashed and its buffer may be reused
+    std::function<void(uint64_t seq, void const* data)> on_release;
+    uint64_t seal_every = 0;  ///< call on_seal every seal_every records (0 - never)
+    /// receives the digest of records [0, seq] in the same layout as StreebogStream::finalize()
+    std::function<void(uint64_t seq, void const* digest)> on_seal;
+  };
+
+  OrderedIngest(const Streebog::Mode mode, Config cfg);
+  explicit OrderedIngest(const Streebog::Mode mode) : OrderedIngest(mode, Config{}) {}
+  ~OrderedIngest();
+
+  OrderedIngest(const OrderedIngest&) = delete;
+  OrderedIngest& operator=(const OrderedIngest&) = delete;
+
+  /**
+   * @brief hands a record over to the hashing thread
+   * @param seq record sequence number; every number in [0, count) must be published exactly once
+   * @param m record data (not copied)
+   * @param size data size in bytes
+   * @note blocks only if seq is capacity or more records ahead of the hashing thread
+   */
+  void publish(const uint64_t seq, void const* m, const uint64_t size);
+
+  /**
+   * @brief number of leading records which have already been hashed
+   */
+  uint64_t consumed() const { return done.load(std::memory_order_acquire); }
+
+  /**
+   * @brief waits for records [0, count) to be hashed and stops the hashing thread
+   * @param count total number of records
+   * @param out array of Streebog::digest_size() bytes for writing output
+   */
+  void finish(const uint64_t count, void* out);
+
+ private:
+  static constexpr uint64_t END = ~0ULL;  ///< size of the sentinel record published by finish()
+
+  void run();
+
+  Config cfg;
+  uint64_t mask;
+  std::unique_ptr<Slot[]> ring;
+  StreebogStream stream;
+  alignas(64) std::atomic<uint64_t> done{};
+  std::thread worker;
+};
@@ -0,0 +1,126 @@
+/**
+ * @file    merkle.hh
+ * @brief   Incremental Merkle tree of Streebog-256 digests over fixed-size blocks of a file or a block device
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#pragma once
+#include <stdint.h>
+
+#include <utility>
+#include <vector>
+
+#include "streebog.hh"
+
+/**
+ * @brief nodes needed to recompute the root from the leaves of a range, see MerkleTree::prove()
+ */
+struct MerkleProof {
+  uint64_t leaves;             ///< number of leaves of the tree
+  uint64_t first, last;        ///< leaves of the range, inclusive
+  std::vector<uint8_t> nodes;  ///< 32 bytes each, from the bottom level up, left sibling before right one
+};
+
+/**
+ * @brief Merkle tree whose leaves are Streebog-256 digests of the blocks of a file
+ * @details
+ * Leaf i is the Streebog-256 of the byte 0x00 followed by bytes [i * leaf, (i + 1) * leaf) of the file, the last
+ * one may be shorter; an empty file has one leaf, the digest of the single tag byte. A node is the Streebog-256 of
+ * the byte 0x01 followed by the 64 bytes of its left and right child digests, so a block holding two digests never
+ * hashes to their parent; the last node of a level that has no right sibling is carried up unchanged. The root is the
+ * Streebog-256 of the byte 0x02, the number of leaves (8 bytes, little-endian) and the top node, so a proof made up
+ * for a tree of another number of leaves does not reach it even where the top nodes would agree. All levels
+ * are kept in memory, leaves first (2 * 32 bytes per block, 64MB for a 1TB image with 1MB leaves).
+ * Leaves are hashed by a pool of threads reading LANES blocks at a time and hashing them together with the
+ * multi-lane kernel (see streebog_batch()); every level of nodes is one streebog_batch() call as well.
+ */
+class MerkleTree {
+ public:
+  struct Config {
+    uint64_t leaf = 1ULL << 20;  ///< block size
+    unsigned threads = 0;        ///< leaf hashing threads, 0 - one per hardware thread
+  };
+
+  explicit MerkleTree(Config const& _cfg) : cfg{_cfg} {}
+  MerkleTree() : MerkleTree(Config{}) {}
+
+  /**
+   * @brief hashes the whole file
+   * @param fd file or block device descriptor, read with pread(); it is not closed
+   * @return 0 or errno value, EINVAL for a zero leaf size
+   */
+  int build(const int fd);
+
+  /**
+   * @brief rehashes the leaves overlapping a written range and their ancestors
+   * @details if the file has grown or shrunk, the leaves from the old end to the new one are rehashed too
+   * @param fd the file the tree was built of
+   * @param off offset of the written range
+   * @param size size of the written range
+   * @return 0 or errno value
+   */
+  int update(const int fd, const uint64_t off, const uint64_t size);
+
+  /**
+   * @brief rehashes the leaves of several written ranges and their common ancestors once
+   * @param ranges (offset, size) pairs
+   */
+  int update(const int fd, std::vector<std::pair<uint64_t, uint64_t>> const& ranges);
+
+  void root(void* out) const;  ///< writes the 32-byte root digest
+  uint64_t leaves() const { return count[0]; }
+  uint64_t file_size() const { return size; }
+  uint64_t leaf_size() const { return cfg.leaf; }
+
+  /**
+   * @brief collects the nodes that prove leaves [first, last] against the root, at most two per level
+   * @return 0, EINVAL if the range is empty or out of the tree
+   */
+  int prove(const uint64_t first, const uint64_t last, MerkleProof& proof) const;
+
+  /**
+   * @brief computes a leaf digest the way the tree does, for verify()
+   * @param data block of the file
+   * @param size block size
+   * @param out array of 32 bytes
+   */
+  static void hash_leaf(void const* data, const uint64_t size, void* out);
+
+  /**
+   * @brief checks leaves against a root
+   * @param root 32-byte root digest
+   * @param proof proof made by prove()
+   * @param leaves digests of leaves [proof.first, proof.last] made by hash_leaf(), 32 bytes each
+   * @return true if they hash up to the root
+   */
+  static bool verify(void const* root, MerkleProof const& proof, void const* leaves);
+
+  /**
+   * @brief writes the tree: leaf size, file size, number of leaves (little-endian) and all node digests
+   * @return 0 or errno value
+   */
+  int save(const int fd) const;
+
+  /**
+   * @brief reads a tree written by save(); the leaf size in the file replaces the configured one
+   * @return 0 or errno value, EBADMSG if the data is not a valid tree (or one saved before the leaf and node tags)
+   */
+  int load(const int fd);
+
+ private:
+  void layout(const uint64_t leaves);
+  int hash_leaves(const int fd, std::vector<uint64_t> const& idx);
+  void hash_nodes(std::vector<std::pair<uint64_t, uint64_t>> dirty);
+  uint8_t* node(const uint64_t level, const uint64_t i) { return nodes.data() + (offset[level] + i) * 32; }
+  uint8_t const* node(const uint64_t level, const uint64_t i) const {
+    return nodes.data() + (offset[level] + i) * 32;
+  }
+
+  Config cfg;
+  uint64_t size{};
+  std::vector<uint64_t> count{0}, offset{0};  ///< nodes of every level and index of its first node, leaves first
+  std::vector<uint8_t> nodes;
+};
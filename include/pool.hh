@@ -0,0 +1,100 @@
+/**
+ * @file    pool.hh
+ * @brief   Arena of reusable cache-line aligned hashing contexts
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <utility>
+
+#include "streebog.hh"
+
+/**
+ * @brief fixed-size arena of contexts (Streebog or StreebogStream) with a lock-free free list
+ * @details
+ * All slots are allocated once. Every slot starts on a cache line boundary and is padded to a whole number of
+ * lines, so contexts used by different threads never share a line. acquire() pops a slot and constructs a fresh
+ * context in it (which is just the IV copy of reset()), the returned handle puts the slot back on destruction.
+ * The free list is a Treiber stack with a generation tag against ABA.
+ */
+template <typename T>
+class ContextPool {
+  static constexpr uint32_t NIL = ~0U;
+
+  struct alignas(64) Slot {
+    alignas(64) unsigned char ctx[sizeof(T)];
+    std::atomic<uint32_t> next;
+  };
+
+  struct Release {
+    ContextPool* pool;
+    void operator()(T* ctx) const { pool->release(ctx); }
+  };
+
+ public:
+  using Ptr = std::unique_ptr<T, Release>;  ///< owning handle, dereferences to the context
+
+  /**
+   * @param capacity number of slots
+   * @note if the slots cannot be allocated, the pool is left empty: capacity() is 0 and acquire() fails
+   */
+  explicit ContextPool(const uint32_t capacity)
+      : slots{(Slot*)aligned_alloc(64, (uint64_t)capacity * sizeof(Slot))}, cap{slots ? capacity : 0} {
+    for (uint32_t i{}; i < cap; i++) new (&slots[i]) Slot{{}, {i + 1 < cap ? i + 1 : NIL}};
+    head.store(cap ? 0 : NIL, std::memory_order_relaxed);
+  }
+
+  ~ContextPool() { free(slots); }  ///< every handle must be released before
+
+  ContextPool(const ContextPool&) = delete;
+  ContextPool& operator=(const ContextPool&) = delete;
+
+  /**
+   * @brief number of slots, 0 if their allocation has failed
+   */
+  uint32_t capacity() const { return cap; }
+
+  /**
+   * @brief takes a free slot and constructs a reset context in it
+   * @param mode operating mode of the context
+   * @return handle to the context or an empty handle if the pool is exhausted
+   */
+  Ptr acquire(const Streebog::Mode mode) {
+    auto h = head.load(std::memory_order_acquire);
+    for (;;) {
+      auto idx = (uint32_t)h;
+      if (idx == NIL) return Ptr{nullptr, Release{this}};
+      auto nh = ((h >> 32) + 1) << 32 | slots[idx].next.load(std::memory_order_relaxed);
+      if (head.compare_exchange_weak(h, nh, std::memory_order_acq_rel, std::memory_order_acquire))
+        return Ptr{new (slots[idx].ctx) T{mode}, Release{this}};
+    }
+  }
+
+ private:
+  void release(T* ctx) {
+    ctx->~T();
+    auto idx = (uint32_t)((Slot*)ctx - slots);  // ctx is the first member of the slot
+    auto h = head.load(std::memory_order_relaxed);
+    for (;;) {
+      slots[idx].next.store((uint32_t)h, std::memory_order_relaxed);
+      auto nh = ((h >> 32) + 1) << 32 | idx;
+      if (head.compare_exchange_weak(h, nh, std::memory_order_release, std::memory_order_relaxed)) return;
+    }
+  }
+
+  Slot* const slots;
+  const uint32_t cap;
+  alignas(64) std::atomic<uint64_t> head;  ///< generation << 32 | index of the first free slot
+};
+
+using StreebogPool = ContextPool<Streebog>;
+using StreebogStreamPool = ContextPool<StreebogStream>;
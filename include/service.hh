@@ -0,0 +1,133 @@
+/**
+ * @file    service.hh
+ * @brief   Thread pool hashing service with completion callbacks
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#pragma once
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "streebog.hh"
+
+/**
+ * @brief owns a work-stealing thread pool and hashes submitted buffers and files on it
+ * @details
+ * Jobs are spread over per-worker deques; an idle worker steals from the others. A worker taking a small buffer
+ * job also takes the small jobs of the same mode queued behind it and hashes them together with streebog_batch(),
+ * larger buffers are hashed on their own with a stream context. Buffers above Config::large_job go to a separate
+ * set of Config::large_threads workers, so a multi-GB job never holds up the small jobs queued on a worker. Every
+ * worker keeps its own stream contexts, read buffer and batch scratch arrays (reserved for Config::batch jobs) and
+ * reuses them, so nothing is allocated per job.
+ */
+class HashService {
+ public:
+  /// receives 0 and the digest (Streebog::digest_size() bytes) or an errno value and nullptr
+  using Callback = std::function<void(int err, void const* digest)>;
+
+  struct Config {
+    unsigned threads = 0;             ///< number of workers (0 - one per hardware thread)
+    uint64_t small_job = 1ULL << 16;  ///< buffers up to this size are batched
+    uint64_t batch = 32;              ///< max number of small jobs hashed together
+    uint64_t read_size = 1ULL << 20;  ///< read buffer of every worker for fd jobs
+    uint64_t large_job = 1ULL << 24;  ///< buffers above this size are hashed by the large job workers
+    unsigned large_threads = 1;       ///< number of large job workers (0 - large buffers go to the others)
+  };
+
+  struct WorkerStats {
+    uint64_t jobs;     ///< completed jobs
+    uint64_t bytes;    ///< hashed bytes
+    uint64_t busy_ns;  ///< time spent on jobs
+    double utilization;  ///< busy_ns / service uptime
+  };
+
+  explicit HashService(Config cfg);
+  HashService() : HashService(Config{}) {}
+  ~HashService();  ///< completes every submitted job
+
+  HashService(const HashService&) = delete;
+  HashService& operator=(const HashService&) = delete;
+
+  /**
+   * @brief queues hashing of a buffer
+   * @param m input data (not copied, must stay valid until the callback is called)
+   * @param size data size in bytes
+   * @param mode operating mode
+   * @param cb completion callback, called on a worker thread
+   */
+  void submit(void const* m, const uint64_t size, const Streebog::Mode mode, Callback cb);
+
+  /**
+   * @brief queues hashing of a file from its current offset up to the end
+   * @param fd file descriptor (not closed, must stay open until the callback is called)
+   * @param mode operating mode
+   * @param cb completion callback, called on a worker thread
+   */
+  void submit(const int fd, const Streebog::Mode mode, Callback cb);
+
+  /**
+   * @brief waits until every job submitted so far is completed
+   */
+  void wait();
+
+  /**
+   * @brief number of jobs which are submitted but not started yet
+   */
+  uint64_t queue_depth() const {
+    return queued.load(std::memory_order_relaxed) + queued_large.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief counters of every worker, for sizing the pool: Config::threads workers, then the large job ones
+   */
+  std::vector<WorkerStats> stats() const;
+
+ private:
+  struct Job {
+    void const* m;
+    uint64_t size;
+    int fd;  ///< -1 for buffer jobs
+    Streebog::Mode mode;
+    Callback cb;
+  };
+
+  struct alignas(64) Worker {
+    std::mutex mtx;
+    std::deque<Job> q;
+    std::atomic<uint64_t> jobs{}, bytes{}, busy_ns{};
+    std::thread th;
+
+    // owned by the worker thread
+    StreebogStream stream512{Streebog::Mode::H512}, stream256{Streebog::Mode::H256};  ///< contexts of fd jobs
+    std::vector<uint64_t> digests;  ///< scratch of hash_small()
+    std::vector<void const*> m;
+    std::vector<void*> out;
+    std::vector<uint64_t> size;
+  };
+
+  void push(Job job);
+  bool pop(const uint64_t self, std::vector<Job>& out);
+  void run(const uint64_t self);
+  void hash_small(std::vector<Job>& jobs, Worker& w);
+  void hash_buffer(Job& job, Worker& w);
+  void hash_fd(Job& job, Worker& w, uint8_t* buff);
+
+  Config cfg;
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::atomic<uint64_t> queued{}, queued_large{}, unfinished{}, next{}, next_large{};
+  std::mutex idle_mtx;
+  std::condition_variable idle_cv, large_cv, done_cv;
+  bool stop{};
+  const uint64_t started_ns;
+};
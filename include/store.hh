@@ -0,0 +1,156 @@
+/**
+ * @file    store.hh
+ * @brief   Content-addressed chunk store keyed by Streebog-256
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#pragma once
+#include <stdint.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "streebog.hh"
+
+/**
+ * @brief chunk size limits of the content-defined chunking
+ */
+struct ChunkerConfig {
+  uint32_t min = 1U << 14;  ///< no cut is made before min bytes
+  uint32_t avg = 1U << 16;  ///< normal chunk size, a power of two not below 64
+  uint32_t max = 1U << 18;  ///< a cut is forced at max bytes
+};
+
+/**
+ * @brief finds the end of the next chunk with the FastCDC gear hash
+ * @details
+ * The gear fingerprint fp = (fp << 1) + GEAR[byte] depends on the last 64 bytes only, so the cuts move with the
+ * content: an insertion or deletion changes the chunks around it and no others. Normalized chunking uses a stricter
+ * mask before avg bytes and a looser one after, which narrows the distribution of chunk sizes around avg.
+ * @param p data starting at the beginning of a chunk
+ * @param size bytes available; unless they are the end of the stream, at least cfg.max must be given
+ * @param cfg chunk size limits
+ * @return length of the chunk, size if it is not larger than cfg.min
+ */
+uint64_t cdc_cut(uint8_t const* p, const uint64_t size, ChunkerConfig const& cfg);
+
+/**
+ * @brief a chunk of a stored file
+ */
+struct ChunkRef {
+  uint8_t digest[32];  ///< Streebog-256 of the chunk
+  uint32_t size;
+};
+
+/**
+ * @brief what ChunkStore::put() has done
+ */
+struct StoreStats {
+  uint64_t bytes, chunks;          ///< read from the file
+  uint64_t new_bytes, new_chunks;  ///< not in the store before, written to packfiles
+};
+
+/**
+ * @brief deduplicating store of chunks in packfiles with a persistent digest index
+ * @details
+ * A store is a directory holding packfiles and an index. Packfiles (pack-00000000, pack-00000001, ...) are append
+ * only: every chunk is written once as a 36-byte header (size, digest) followed by the data, and a new packfile is
+ * started once the current one has reached Config::pack_size. The index maps digests to packfile locations. It is an
+ * open-addressing table with linear probing kept in a file that is used through a shared mapping, so opening a store
+ * reads nothing but the pages that lookups touch; it is doubled (rewritten into a new file renamed over the old one)
+ * when it gets 70% full. New chunks are buffered and indexed only once their data has been written to the packfile;
+ * the index is marked until flush() has synced both, and opening a marked store (one not flushed before a crash)
+ * drops the entries pointing past the end of their packfile, so the chunks lost with the crash are stored again.
+ *
+ * put() runs as a pipeline: a reader thread reads the file and finds the chunk boundaries in segments of several
+ * megabytes, a pool of workers hashes the chunks of whole segments with the multi-lane kernel (see streebog_batch()),
+ * and the calling thread looks the digests up in segment order and appends the new chunks to the packfile.
+ * Chunk sizes are fixed when the store is created and kept in the index.
+ * @warning a store must not be used by several threads or processes at once
+ */
+class ChunkStore {
+ public:
+  struct Config {
+    ChunkerConfig chunker;                 ///< used when the store is created
+    uint64_t pack_size = 1ULL << 28;       ///< size at which a new packfile is started
+    uint64_t index_capacity = 1ULL << 16;  ///< initial number of index slots, rounded up to a power of two
+    unsigned threads = 0;                  ///< hashing workers of put(), 0 - one per hardware thread
+  };
+
+  /**
+   * @brief opens a store, creating the directory and the index if there are none
+   * @param dir store directory
+   * @param cfg settings; only pack_size and threads apply to an existing store
+   */
+  ChunkStore(char const* dir, Config const& cfg);
+  explicit ChunkStore(char const* dir) : ChunkStore(dir, Config{}) {}
+  ~ChunkStore();  ///< flushes the store
+
+  ChunkStore(const ChunkStore&) = delete;
+  ChunkStore& operator=(const ChunkStore&) = delete;
+
+  /**
+   * @return 0 if the store has been opened, errno value otherwise; EBADMSG for a damaged index
+   */
+  int status() const { return err; }
+
+  /**
+   * @brief chunks a file and stores the chunks not stored yet
+   * @param fd file descriptor, read from its current offset up to the end; may be a pipe; it is not closed
+   * @param recipe receives the chunks of the file in order
+   * @param stats receives the amounts read and written, may be nullptr
+   * @return 0 or errno value
+   */
+  int put(const int fd, std::vector<ChunkRef>& recipe, StoreStats* stats = nullptr);
+
+  /**
+   * @brief reads a chunk and checks that its data still hashes to the digest
+   * @return 0 or errno value, ENOENT if there is no such chunk, EBADMSG if the data is damaged
+   */
+  int get(uint8_t const* digest, std::vector<uint8_t>& out);
+
+  /**
+   * @brief writes the chunks of a recipe one after another
+   * @return 0 or errno value as for get()
+   */
+  int restore(std::vector<ChunkRef> const& recipe, const int fd);
+
+  bool contains(uint8_t const* digest) const;
+  uint64_t size() const;  ///< number of chunks stored
+
+  /**
+   * @brief writes the buffered data out and syncs packfiles and the index to the disk
+   * @return 0 or errno value
+   */
+  int flush();
+
+ private:
+  struct Header;
+  struct Slot;
+  struct Segment;
+
+  Slot const* find(uint8_t const* digest) const;
+  int insert(Slot const& s);
+  int recover();
+  int map_index(const int fd);
+  int grow();
+  int append(uint8_t const* data, ChunkRef const& c);
+  int pack_fd(const uint32_t pack);
+  int flush_pack();
+
+  std::string dir;
+  Config cfg;
+  int err{};
+  Header* index{};  ///< mapped index file
+  uint64_t index_sz{};
+  int index_fd = -1;
+  std::vector<int> packs;                                  ///< opened packfiles, -1 - not opened yet
+  std::vector<uint8_t> pack_buf;                           ///< data appended to the last packfile but not written yet
+  std::vector<Slot> pending;                               ///< index entries of the chunks in pack_buf
+  std::unordered_multimap<uint64_t, uint64_t> pending_at;  ///< first 8 bytes of a digest -> position in pending
+  uint64_t pack_len{};                                     ///< size of the last packfile including pack_buf
+};
@@ -25,6 +25,7 @@ class Streebog {
   alignas(32) uint64_t sum[8];                            ///< Σ variable (sum of all data blocks)
   alignas(32) uint64_t h[8];                              ///< h variable (output hash)
   void G(uint64_t const* const m, bool is_zero = false);  ///< implementation of G transformation
+  void G_zero();                                          ///< G transformation of an all-zero block
 
  public:
   /**
@@ -59,6 +60,14 @@ class Streebog {
    */
   uint64_t const* const finalize(void* m, const uint64_t size);
 
+  /**
+   * @brief calculates the partial hash of all-zero blocks
+   * @param blocks number of 64-byte blocks
+   * @details same as update() of blocks * 64 zero bytes, but no message is loaded and Σ, which zero blocks do not
+   * change, is not touched; meant for holes of sparse files
+   */
+  void update_zeros(const uint64_t blocks);
+
   /**
    * @brief alias for finalize() method
    * @param m input data
@@ -67,6 +76,152 @@ class Streebog {
    * and then the function will work exactly the same as finalize()
    */
   uint64_t const* const operator()(void* m, const uint64_t size, void* out = nullptr);
+
+  static constexpr uint64_t LANES = 2;  ///< max number of states interleaved by update_lanes()
+
+  /**
+   * @brief calculates the partial hashes of several independent messages at once
+   * @param ctx contexts to update, one per message
+   * @param m input data, one pointer per context
+   * @param count number of contexts
+   * @param size data size in bytes, the same for every context
+   * @details the contexts are advanced in groups of up to LANES with interleaved G transformations, which keeps
+   * more table lookups in flight than a single dependency chain does
+   */
+  static void update_lanes(Streebog* const* ctx, void const* const* m, const uint64_t count, const uint64_t size);
+
+  /**
+   * @brief size of the resulting hash in bytes for the given mode
+   */
+  static constexpr uint64_t digest_size(const Mode _mode) { return _mode == Mode::H512 ? 64 : 32; }
+
+  /**
+   * @brief state of the context between two blocks
+   * @details a context resumed from a midstate continues the message exactly where the saved one stopped, so the
+   * hash of a growing message can be carried on instead of calculated from the start
+   */
+  struct Midstate {
+    uint64_t h[8];    ///< h variable
+    uint64_t n[8];    ///< N variable
+    uint64_t sum[8];  ///< Σ variable
+  };
+
+  Midstate midstate() const;
+
+  /**
+   * @brief replaces the state with a saved one
+   * @param s midstate of a context of the same mode
+   */
+  void resume(Midstate const& s);
+};
+
+/**
+ * @brief calculates Streebog-512 and Streebog-256 of the same message in one pass
+ * @details
+ * The two chains differ only in IV and truncation, so every block is loaded once and both states are advanced
+ * together by the 2-lane kernel (see Streebog::update_lanes()). Accepts chunks of arbitrary length like
+ * StreebogStream.
+ */
+class StreebogDual {
+  Streebog h512{Streebog::Mode::H512};  ///< 512-bit chain
+  Streebog h256{Streebog::Mode::H256};  ///< 256-bit chain
+  alignas(32) uint8_t buff[64];         ///< incomplete block
+  uint64_t buff_sz{};                   ///< number of bytes in buff
+
+ public:
+  /**
+   * @brief forcibly resets both states, including the buffered tail
+   */
+  void reset();
+
+  /**
+   * @brief appends a chunk of data of any size to the message
+   * @param m input data
+   * @param size data size in bytes
+   */
+  void update(void const* m, const uint64_t size);
+
+  /**
+   * @brief completes both hash calculations
+   * @param out512 array of 64 bytes for the 512-bit hash
+   * @param out256 array of 32 bytes for the 256-bit hash
+   * @warning the state is consumed; call reset() before reusing the object
+   */
+  void finalize(void* out512, void* out256);
+};
+
+/**
+ * @brief calculates the hashes of many independent messages using the multi-lane kernel
+ * @param mode operating mode for every message
+ * @param count number of messages
+ * @param m input data, one pointer per message
+ * @param size data sizes in bytes
+ * @param out arrays of Streebog::digest_size() bytes for writing output, one per message
+ * @note lanes are filled in the given order, so passing messages of similar size next to each other is faster
+ */
+void streebog_batch(const Streebog::Mode mode, const uint64_t count, void const* const* m, uint64_t const* size,
+                    void* const* out);
+
+/**
+ * @brief buffered wrapper over Streebog accepting chunks of arbitrary length
+ * @details
+ * Streebog::update() only consumes whole 64-byte blocks, so the caller has to keep the tail by itself.
+ * This class does it: whole blocks go straight to the context, the remainder (< 64 bytes) is kept in the
+ * internal buffer until the next call to update() or finalize()
+ */
+class StreebogStream {
+  Streebog ctx;                  ///< underlying context
+  alignas(32) uint8_t buff[64];  ///< incomplete block
+  uint64_t buff_sz{};            ///< number of bytes in buff
+
+ public:
+  explicit StreebogStream(const Streebog::Mode _mode);
+
+  /**
+   * @brief forcibly resets the state, including the buffered tail
+   */
+  void reset();
+
+  Streebog::Mode mode() const { return ctx.mode; }
+
+  /**
+   * @brief appends a chunk of data of any size to the message
+   * @param m input data
+   * @param size data size in bytes
+   */
+  void update(void const* m, const uint64_t size);
+
+  /**
+   * @brief appends size zero bytes to the message (see Streebog::update_zeros())
+   */
+  void update_zeros(const uint64_t size);
+
+  /**
+   * @brief completes the hash calculation
+   * @param out array of Streebog::digest_size() bytes for writing output (same layout as Streebog::operator())
+   * @warning the state is consumed; call reset() before reusing the object
+   */
+  void finalize(void* out);
+
+  /**
+   * @brief calculates the hash of the data appended so far without changing the state
+   * @param out array of Streebog::digest_size() bytes for writing output
+   */
+  void digest(void* out) const;
+
+  /**
+   * @brief state after the data appended so far
+   * @warning only meaningful when the size appended so far is a multiple of 64, i.e. nothing is buffered
+   */
+  Streebog::Midstate midstate() const { return ctx.midstate(); }
+
+  /**
+   * @brief replaces the state with a saved one, dropping the buffered tail
+   */
+  void resume(Streebog::Midstate const& s) {
+    ctx.resume(s);
+    buff_sz = 0;
+  }
 };
 
 #ifdef STREEBOG_ENABLE_WRAPPERS
@@ -0,0 +1,64 @@
+/**
+ * @file    tree.hh
+ * @brief   Streebog-Tree: a NON-STANDARD parallel hash of large files built of Streebog
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#pragma once
+#include <stdint.h>
+
+#include <functional>
+#include <vector>
+
+#include "streebog.hh"
+
+/**
+ * @brief settings of hash_fd_tree()
+ */
+struct TreeConfig {
+  uint64_t leaf = 1ULL << 20;  ///< leaf size; it is part of the result
+  unsigned threads = 0;        ///< leaf hashing threads, 0 - one per hardware thread
+};
+
+/**
+ * @brief calculates the Streebog-Tree hash of the data from the current offset of fd up to its end
+ * @details
+ * Streebog-Tree is NOT the GOST 34.11-2018 hash of the data and never equals it; it is meant for internal integrity
+ * checks of files too large to be hashed at the speed of one core. With H the Streebog hash of the given mode:
+ *  - leaf i = H(0x00 || bytes [i * leaf, (i + 1) * leaf) of the data), the last leaf may be shorter; empty data has
+ *    one leaf, H(0x00);
+ *  - node = H(0x01 || left || right); the last node of a level with no right sibling is carried up unchanged;
+ *  - result = H(0x02 || leaf || size || top node), leaf and size as 64-bit little-endian numbers.
+ * The prefix bytes keep leaves, nodes and the result apart, so no leaf can be passed off as a node. Leaves are read
+ * with pread() by a pool of threads, LANES at a time, and hashed together with the multi-lane kernel
+ * (see streebog_batch()); the result does not depend on the number of threads.
+ * @param fd file or block device descriptor; it is not closed, its offset is left at the end
+ * @param mode operating mode
+ * @param out array of Streebog::digest_size() bytes for writing output
+ * @param cfg leaf size and number of threads
+ * @return 0 or errno value, ESPIPE for pipes and other descriptors that cannot be read with pread(), EINVAL for a zero
+ * leaf size
+ */
+int hash_fd_tree(const int fd, const Streebog::Mode mode, void* out, TreeConfig const& cfg = {});
+
+/**
+ * @brief hashes leaves of the data the way hash_fd_tree() does; MerkleTree hashes its leaves with it too
+ * @details
+ * Leaf i is the digest of the byte 0x00 followed by bytes [i * cfg.leaf, (i + 1) * cfg.leaf) of the data, the last
+ * one may be shorter. The leaves are read with pread() by a pool of cfg.threads threads, Streebog::LANES at a time,
+ * and hashed together with the multi-lane kernel (see streebog_batch()).
+ * @param fd file descriptor, it is not closed
+ * @param mode operating mode
+ * @param start offset of the data in the file
+ * @param size size of the data
+ * @param cfg leaf size and number of threads
+ * @param idx leaves to hash
+ * @param out returns where the digest of leaf i goes; called from the pool threads
+ * @return 0 or errno value, EIO if the file is shorter than start + size
+ */
+int hash_tree_leaves(const int fd, const Streebog::Mode mode, const uint64_t start, const uint64_t size,
+                     TreeConfig const& cfg, std::vector<uint64_t> const& idx,
+                     std::function<void*(uint64_t)> const& out);
@@ -0,0 +1,91 @@
+/**
+ * @file    uring.hh
+ * @brief   io_uring based file reader feeding Streebog contexts
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#pragma once
+#include <stdint.h>
+
+#include "streebog.hh"
+
+/**
+ * @brief hashes regular files keeping many reads in flight through io_uring
+ * @details
+ * Talks to the kernel with raw io_uring_setup/io_uring_enter syscalls, so liburing is not needed. The reader owns
+ * depth buffers of chunk bytes, registered as fixed buffers when RLIMIT_MEMLOCK allows. Reads of one or several
+ * files are issued into free buffers round-robin; completed buffers are handed to the context of their file strictly
+ * in file order. Buffers are 4KB aligned, so files may be opened with O_DIRECT.
+ * If io_uring is not available (old kernel, seccomp), available() is false and every call falls back to
+ * hash_fd_pipelined(); non-regular files always fall back as well.
+ */
+class UringReader {
+ public:
+  struct Config {
+    uint32_t depth = 16;          ///< number of buffers = max number of reads in flight
+    uint64_t chunk = 1ULL << 19;  ///< size of one read, rounded up to 4KB
+  };
+
+  explicit UringReader(Config cfg);
+  UringReader() : UringReader(Config{}) {}
+  ~UringReader();
+
+  UringReader(const UringReader&) = delete;
+  UringReader& operator=(const UringReader&) = delete;
+
+  bool available() const { return ring_fd >= 0; }
+
+  /**
+   * @brief calculates the hash of the data from the current offset of fd up to its end
+   * @param fd file descriptor, it is not closed
+   * @param mode operating mode
+   * @param out array of Streebog::digest_size() bytes for writing output
+   * @return 0 or errno value
+   */
+  int hash_fd(const int fd, const Streebog::Mode mode, void* out);
+
+  /**
+   * @brief calculates the hashes of several files at once, sharing the reads in flight among them
+   * @param count number of files
+   * @param fd file descriptors, they are not closed
+   * @param mode operating mode for every file
+   * @param out arrays of Streebog::digest_size() bytes for writing output, one per file
+   * @param err receives 0 or errno value for every file
+   */
+  void hash_fds(const uint64_t count, int const* fd, const Streebog::Mode mode, void* const* out, int* err);
+
+  /**
+   * @brief feeds a range of a file into a context
+   * @details
+   * Reads are chunk bytes long except the last one, so with O_DIRECT off and size must be multiples of the logical
+   * block size of the device. The file offset of fd is not used and not changed.
+   * @param fd file descriptor, it is not closed
+   * @param off offset of the range
+   * @param size size of the range; it ends earlier if the file is shorter
+   * @param ctx context to update
+   * @return 0 or errno value, ENOSYS if io_uring is not available
+   */
+  int update(const int fd, const uint64_t off, const uint64_t size, StreebogStream& ctx);
+
+ private:
+  struct Buffer;
+  struct Stream;
+
+  void read(Stream* streams, const uint64_t count);
+  bool submit(const uint32_t buf, const int fd, const uint64_t off, const uint32_t len);
+  int reap(Buffer* bufs);
+
+  Config cfg;
+  int ring_fd = -1;
+  bool fixed{};  ///< buffers are registered
+  uint8_t* pool{};
+  void *sq_ptr{}, *cq_ptr{}, *sqes{};
+  uint64_t sq_sz{}, cq_sz{}, sqes_sz{};
+  unsigned *sq_head{}, *sq_tail{}, *sq_mask{}, *sq_array{};
+  unsigned *cq_head{}, *cq_tail{}, *cq_mask{};
+  void* cqes{};
+  uint32_t to_submit{};
+};
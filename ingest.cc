@@ -0,0 +1,99 @@
+/**
+ * @file    ingest.cc
+ * @brief   Implementation of ordered multi-producer ingestion into a single Streebog hash chain
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#include "ingest.hh"
+
+#include <utility>
+
+using ui64 = uint64_t;
+
+static constexpr ui64 ABORT_TAG = ~0ULL;  ///< wakes the hashing thread when the object is destroyed early
+
+OrderedIngest::OrderedIngest(const Streebog::Mode mode, Config _cfg) : cfg{std::move(_cfg)}, stream{mode} {
+  ui64 cap = 1;
+  while (cap < cfg.capacity) cap <<= 1;
+  cfg.capacity = cap, mask = cap - 1;
+  if (!cfg.batch) cfg.batch = 1;
+
+  ring.reset(new Slot[cap]);
+  for (ui64 i{}; i < cap; i++) ring[i].tag.store(i << 1, std::memory_order_relaxed);
+
+  worker = std::thread([this] { run(); });
+}
+
+OrderedIngest::~OrderedIngest() {
+  if (!worker.joinable()) return;
+
+  for (;;) {  // finish() was not called: stop at the first record which is not published yet
+    auto d = consumed();
+    auto& s = ring[d & mask];
+    auto t = d << 1;
+    if (s.tag.compare_exchange_strong(t, ABORT_TAG, std::memory_order_acq_rel)) {
+      s.tag.notify_all();
+      break;
+    }
+    std::this_thread::yield();
+  }
+  worker.join();
+}
+
+void OrderedIngest::publish(const ui64 seq, void const* m, const ui64 size) {
+  auto& s = ring[seq & mask];
+  const ui64 free_tag = seq << 1;
+  for (ui64 t; (t = s.tag.load(std::memory_order_acquire)) != free_tag;) s.tag.wait(t, std::memory_order_acquire);
+
+  s.data = m, s.size = size;
+  s.tag.store(free_tag | 1, std::memory_order_release);
+  s.tag.notify_all();
+}
+
+void OrderedIngest::finish(const ui64 count, void* out) {
+  publish(count, nullptr, END);
+  worker.join();
+  stream.finalize(out);
+}
+
+void OrderedIngest::run() {
+  alignas(32) uint8_t digest[64];
+  ui64 next{};
+
+  for (bool end{}; !end;) {
+    auto& head = ring[next & mask];
+    for (ui64 t; (t = head.tag.load(std::memory_order_acquire)) != ((next << 1) | 1);) {
+      if (t == ABORT_TAG) return;
+      head.tag.wait(t, std::memory_order_acquire);
+    }
+
+    ui64 n{};  // hash every published record in a row, but no more than cfg.batch
+    for (; n < cfg.batch; n++) {
+      auto& s = ring[(next + n) & mask];
+      if (s.tag.load(std::memory_order_acquire) != (((next + n) << 1) | 1)) break;
+      if (s.size == END) {
+        end = true;
+        break;
+      }
+
+      stream.update(s.data, s.size);
+      if (cfg.seal_every && (next + n + 1) % cfg.seal_every == 0 && cfg.on_seal) {
+        stream.digest(digest);
+        cfg.on_seal(next + n, digest);
+      }
+    }
+
+    for (ui64 i{}; i < n; i++) {
+      auto& s = ring[(next + i) & mask];
+      if (cfg.on_release) cfg.on_release(next + i, s.data);
+      s.tag.store((next + i + cfg.capacity) << 1, std::memory_order_release);
+      s.tag.notify_all();
+    }
+
+    next += n;
+    done.store(next, std::memory_order_release);
+  }
+}
@@ -0,0 +1,235 @@
+/**
+ * @file    merkle.cc
+ * @brief   Implementation of the incremental Merkle tree
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#include "merkle.hh"
+
+#include <endian.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "tree.hh"
+
+using ui64 = uint64_t;
+using Ranges = std::vector<std::pair<ui64, ui64>>;
+
+static constexpr char MAGIC[8] = {'s', 't', 'b', 'g', 'm', 'k', 'l', '2'};  ///< 1 - nodes without tags
+static constexpr uint8_t LEAF_TAG = 0x00;  ///< prefix of a leaf, as in hash_tree_leaves()
+static constexpr uint8_t NODE_TAG = 0x01;  ///< prefix of a node
+static constexpr uint8_t ROOT_TAG = 0x02;  ///< prefix of the root
+
+static int io_full(const int fd, void* p, const ui64 size, const bool write) {
+  for (ui64 done{}; done < size;) {
+    auto n = (write ? ::write(fd, (uint8_t*)p + done, size - done) : ::read(fd, (uint8_t*)p + done, size - done));
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) return errno;
+    if (!n) return EBADMSG;  // a tree file ends early
+    done += n;
+  }
+  return 0;
+}
+
+/**
+ * @brief sorts and merges [lo, hi) intervals
+ */
+static Ranges merge(Ranges r) {
+  std::sort(r.begin(), r.end());
+  Ranges out;
+  for (auto& [lo, hi] : r) {
+    if (lo >= hi) continue;
+    if (!out.empty() && lo <= out.back().second)
+      out.back().second = std::max(out.back().second, hi);
+    else
+      out.push_back({lo, hi});
+  }
+  return out;
+}
+
+static void hash_pair(uint8_t const* children, uint8_t* out) {
+  uint8_t m[65];
+  m[0] = NODE_TAG, memcpy(m + 1, children, 64);
+  Streebog{Streebog::Mode::H256}(m, 65, out);
+}
+
+/**
+ * @brief the root: the top node hashed with the tag and the number of leaves, so a proof for a tree of another
+ * width never reaches it
+ */
+static void hash_root(const ui64 leaves, uint8_t const* top, void* out) {
+  uint8_t m[1 + 8 + 32];
+  const ui64 n = htole64(leaves);
+  m[0] = ROOT_TAG, memcpy(m + 1, &n, 8), memcpy(m + 9, top, 32);
+  Streebog{Streebog::Mode::H256}(m, sizeof(m), out);
+}
+
+void MerkleTree::hash_leaf(void const* data, const uint64_t size, void* out) {
+  StreebogStream s{Streebog::Mode::H256};
+  s.update(&LEAF_TAG, 1), s.update(data, size);
+  s.finalize(out);
+}
+
+void MerkleTree::layout(const ui64 leaves) {
+  std::vector<ui64> c{leaves ? leaves : 1}, o{0};
+  while (c.back() > 1) o.push_back(o.back() + c.back()), c.push_back((c.back() + 1) / 2);
+
+  // nodes that exist in both layouts are kept, the caller rehashes the others
+  std::vector<uint8_t> n((o.back() + c.back()) * 32);
+  for (ui64 l{}; l < c.size() && l < count.size() && !nodes.empty(); l++)
+    memcpy(n.data() + o[l] * 32, node(l, 0), std::min(c[l], count[l]) * 32);
+  count = std::move(c), offset = std::move(o), nodes = std::move(n);
+}
+
+int MerkleTree::hash_leaves(const int fd, std::vector<ui64> const& idx) {
+  return hash_tree_leaves(fd, Streebog::Mode::H256, 0, size, {cfg.leaf, cfg.threads}, idx,
+                          [&](const ui64 i) { return node(0, i); });
+}
+
+void MerkleTree::hash_nodes(Ranges dirty) {
+  std::vector<uint8_t> in;
+  std::vector<void const*> ptr;
+  std::vector<void*> out;
+  std::vector<ui64> len;
+
+  for (ui64 l{}; l + 1 < count.size(); l++) {
+    Ranges up;
+    for (auto [lo, hi] : dirty) up.push_back({lo / 2, std::min((hi + 1) / 2, count[l + 1])});
+    dirty = merge(up);
+
+    // every parent is the hash of the tag and its two children, copied next to each other in one batch
+    in.clear(), out.clear();
+    for (auto [lo, hi] : dirty)
+      for (ui64 p = lo; p < hi; p++) {
+        if (2 * p + 1 < count[l]) {
+          in.push_back(NODE_TAG), in.insert(in.end(), node(l, 2 * p), node(l, 2 * p) + 64);
+          out.push_back(node(l + 1, p));
+        } else {
+          memcpy(node(l + 1, p), node(l, 2 * p), 32);
+        }
+      }
+    ptr.resize(out.size()), len.assign(out.size(), 65);
+    for (ui64 k{}; k < out.size(); k++) ptr[k] = in.data() + k * 65;
+    streebog_batch(Streebog::Mode::H256, out.size(), ptr.data(), len.data(), out.data());
+  }
+}
+
+int MerkleTree::build(const int fd) {
+  if (!cfg.leaf) return EINVAL;
+  const off_t end = lseek(fd, 0, SEEK_END);  // st_size is 0 for block devices
+  if (end < 0) return errno;
+
+  size = end;
+  nodes.clear();
+  layout((size + cfg.leaf - 1) / cfg.leaf);
+  std::vector<ui64> idx(count[0]);
+  for (ui64 i{}; i < idx.size(); i++) idx[i] = i;
+  if (int e = hash_leaves(fd, idx)) return e;
+  hash_nodes({{0, count[0]}});
+  return 0;
+}
+
+int MerkleTree::update(const int fd, std::vector<std::pair<uint64_t, uint64_t>> const& ranges) {
+  if (nodes.empty()) return build(fd);
+  const off_t end = lseek(fd, 0, SEEK_END);
+  if (end < 0) return errno;
+
+  Ranges dirty;
+  const ui64 old_leaves = count[0];
+  if ((ui64)end != size) {  // from the old last leaf, which may have been short, to the new end
+    size = end;
+    layout((size + cfg.leaf - 1) / cfg.leaf);
+    dirty.push_back({std::min(old_leaves, count[0]) - 1, count[0]});
+  }
+  for (auto [off, len] : ranges)
+    if (len && off < size) dirty.push_back({off / cfg.leaf, std::min(count[0], (off + len + cfg.leaf - 1) / cfg.leaf)});
+  dirty = merge(dirty);
+  if (dirty.empty()) return 0;
+
+  std::vector<ui64> idx;
+  for (auto [lo, hi] : dirty)
+    for (ui64 i = lo; i < hi; i++) idx.push_back(i);
+  if (int e = hash_leaves(fd, idx)) return e;
+  hash_nodes(dirty);
+  return 0;
+}
+
+int MerkleTree::update(const int fd, const uint64_t off, const uint64_t len) { return update(fd, {{off, len}}); }
+
+void MerkleTree::root(void* out) const { hash_root(count[0], node(count.size() - 1, 0), out); }
+
+int MerkleTree::prove(const uint64_t first, const uint64_t last, MerkleProof& proof) const {
+  if (nodes.empty() || first > last || last >= count[0]) return EINVAL;
+  proof = {count[0], first, last, {}};
+  ui64 lo = first, hi = last;
+  for (ui64 l{}; l + 1 < count.size(); l++, lo /= 2, hi /= 2) {
+    if (lo & 1) proof.nodes.insert(proof.nodes.end(), node(l, lo - 1), node(l, lo - 1) + 32);
+    if (!(hi & 1) && hi + 1 < count[l]) proof.nodes.insert(proof.nodes.end(), node(l, hi + 1), node(l, hi + 1) + 32);
+  }
+  return 0;
+}
+
+bool MerkleTree::verify(void const* root, MerkleProof const& proof, void const* leaves) {
+  if (!proof.leaves || proof.first > proof.last || proof.last >= proof.leaves || proof.nodes.size() % 32) return false;
+
+  // cur holds nodes [lo, hi] of the level, widened by the siblings from the proof
+  std::vector<uint8_t> cur((uint8_t const*)leaves, (uint8_t const*)leaves + (proof.last - proof.first + 1) * 32);
+  ui64 lo = proof.first, hi = proof.last, k{};
+  for (ui64 w = proof.leaves; w > 1; w = (w + 1) / 2, lo /= 2, hi /= 2) {
+    if (lo & 1) {
+      if (k + 32 > proof.nodes.size()) return false;
+      cur.insert(cur.begin(), proof.nodes.begin() + k, proof.nodes.begin() + k + 32), k += 32, lo--;
+    }
+    if (!(hi & 1) && hi + 1 < w) {
+      if (k + 32 > proof.nodes.size()) return false;
+      cur.insert(cur.end(), proof.nodes.begin() + k, proof.nodes.begin() + k + 32), k += 32, hi++;
+    }
+
+    std::vector<uint8_t> up((hi / 2 - lo / 2 + 1) * 32);
+    for (ui64 i = lo; i <= hi; i += 2) {
+      auto dst = up.data() + (i - lo) / 2 * 32;
+      if (i + 1 <= hi)
+        hash_pair(cur.data() + (i - lo) * 32, dst);
+      else
+        memcpy(dst, cur.data() + (i - lo) * 32, 32);  // the last node of the level, carried up
+    }
+    cur = std::move(up);
+  }
+  if (k != proof.nodes.size() || cur.size() != 32) return false;
+  uint8_t r[32];
+  hash_root(proof.leaves, cur.data(), r);
+  return !memcmp(r, root, 32);
+}
+
+int MerkleTree::save(const int fd) const {
+  if (nodes.empty()) return EINVAL;
+  uint8_t head[32];
+  const ui64 h[] = {htole64(cfg.leaf), htole64(size), htole64(count[0])};
+  memcpy(head, MAGIC, 8), memcpy(head + 8, h, 24);
+  if (int e = io_full(fd, head, 32, true)) return e;
+  return io_full(fd, (void*)nodes.data(), nodes.size(), true);
+}
+
+int MerkleTree::load(const int fd) {
+  uint8_t head[32];
+  ui64 h[3];
+  if (int e = io_full(fd, head, 32, false)) return e;
+  memcpy(h, head + 8, 24);
+  const ui64 leaf = le64toh(h[0]), fsize = le64toh(h[1]), leaves = le64toh(h[2]);
+  if (memcmp(head, MAGIC, 8) || !leaf || leaves != std::max<ui64>(1, (fsize + leaf - 1) / leaf)) return EBADMSG;
+
+  cfg.leaf = leaf, size = fsize;
+  nodes.clear();
+  layout(leaves);
+  if (int e = io_full(fd, nodes.data(), nodes.size(), false)) {
+    nodes.clear();
+    return e;
+  }
+  return 0;
+}
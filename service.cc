@@ -0,0 +1,201 @@
+/**
+ * @file    service.cc
+ * @brief   Implementation of the thread pool hashing service
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#include "service.hh"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+
+using ui64 = uint64_t;
+
+static ui64 now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+HashService::HashService(Config _cfg) : cfg{_cfg}, started_ns{now_ns()} {
+  if (!cfg.threads) cfg.threads = std::thread::hardware_concurrency();
+  if (!cfg.threads) cfg.threads = 1;
+  if (!cfg.batch) cfg.batch = 1;
+  cfg.read_size = (cfg.read_size ? (cfg.read_size + 63) & ~0x3FULL : 64);
+  if (cfg.large_job < cfg.small_job) cfg.large_job = cfg.small_job;
+
+  const unsigned total = cfg.threads + cfg.large_threads;
+  for (unsigned i{}; i < total; i++) workers.emplace_back(new Worker);
+  for (unsigned i{}; i < total; i++) workers[i]->th = std::thread([this, i] { run(i); });
+}
+
+HashService::~HashService() {
+  wait();
+  {
+    std::lock_guard lk{idle_mtx};
+    stop = true;
+  }
+  idle_cv.notify_all();
+  large_cv.notify_all();
+  for (auto& w : workers) w->th.join();
+}
+
+void HashService::submit(void const* m, const ui64 size, const Streebog::Mode mode, Callback cb) {
+  push(Job{m, size, -1, mode, std::move(cb)});
+}
+
+void HashService::submit(const int fd, const Streebog::Mode mode, Callback cb) {
+  push(Job{nullptr, 0, fd, mode, std::move(cb)});
+}
+
+void HashService::push(Job job) {
+  unfinished.fetch_add(1, std::memory_order_relaxed);
+  const bool large = (job.fd < 0 && job.size > cfg.large_job && cfg.large_threads);
+  auto& w = *(large ? workers[cfg.threads + next_large.fetch_add(1, std::memory_order_relaxed) % cfg.large_threads]
+                    : workers[next.fetch_add(1, std::memory_order_relaxed) % cfg.threads]);
+  {
+    std::lock_guard lk{w.mtx};
+    w.q.push_back(std::move(job));
+  }
+  {
+    std::lock_guard lk{idle_mtx};
+    (large ? queued_large : queued).fetch_add(1, std::memory_order_relaxed);
+  }
+  (large ? large_cv : idle_cv).notify_one();
+}
+
+void HashService::wait() {
+  std::unique_lock lk{idle_mtx};
+  done_cv.wait(lk, [&] { return unfinished.load(std::memory_order_acquire) == 0; });
+}
+
+bool HashService::pop(const ui64 self, std::vector<Job>& out) {
+  auto is_small = [&](const Job& j) { return j.fd < 0 && j.size <= cfg.small_job; };
+  const bool large = (self >= cfg.threads);  // the two sets of workers only steal among themselves
+  const ui64 first = (large ? cfg.threads : 0), count = (large ? cfg.large_threads : cfg.threads);
+
+  for (ui64 k{}; k < count; k++) {  // own deque first, then steal from the neighbours
+    auto& w = *workers[first + (self - first + k) % count];
+    std::lock_guard lk{w.mtx};
+    if (w.q.empty()) continue;
+
+    out.push_back(std::move(w.q.front()));
+    w.q.pop_front();
+    while (is_small(out.front()) && out.size() < cfg.batch && !w.q.empty() && is_small(w.q.front()) &&
+           w.q.front().mode == out.front().mode) {
+      out.push_back(std::move(w.q.front()));
+      w.q.pop_front();
+    }
+    (large ? queued_large : queued).fetch_sub(out.size(), std::memory_order_relaxed);
+    return true;
+  }
+
+  return false;
+}
+
+void HashService::run(const ui64 self) {
+  auto& w = *workers[self];
+  auto& pending = (self >= cfg.threads ? queued_large : queued);
+  auto& cv = (self >= cfg.threads ? large_cv : idle_cv);
+  auto buff = (uint8_t*)aligned_alloc(64, cfg.read_size);  // nullptr: fd jobs fail with ENOMEM, buffers still work
+  std::vector<Job> jobs;
+  jobs.reserve(cfg.batch);
+  w.digests.reserve(cfg.batch << 3), w.m.reserve(cfg.batch), w.out.reserve(cfg.batch), w.size.reserve(cfg.batch);
+
+  for (;;) {
+    jobs.clear();
+    if (!pop(self, jobs)) {
+      std::unique_lock lk{idle_mtx};
+      cv.wait(lk, [&] { return stop || pending.load(std::memory_order_relaxed); });
+      if (stop && !pending.load(std::memory_order_relaxed)) break;
+      continue;
+    }
+
+    auto t0 = now_ns();
+    if (jobs.front().fd >= 0)
+      hash_fd(jobs.front(), w, buff);
+    else if (jobs.front().size > cfg.small_job)
+      hash_buffer(jobs.front(), w);
+    else
+      hash_small(jobs, w);
+    w.busy_ns.fetch_add(now_ns() - t0, std::memory_order_relaxed);
+    w.jobs.fetch_add(jobs.size(), std::memory_order_relaxed);
+
+    if (unfinished.fetch_sub(jobs.size(), std::memory_order_acq_rel) == jobs.size()) {
+      std::lock_guard lk{idle_mtx};
+      done_cv.notify_all();
+    }
+  }
+
+  free(buff);
+}
+
+void HashService::hash_small(std::vector<Job>& jobs, Worker& w) {
+  const ui64 k = jobs.size();
+  w.digests.resize(k << 3), w.m.resize(k), w.out.resize(k), w.size.resize(k);  // within the reserved capacity
+  ui64 bytes{};
+  for (ui64 i{}; i < k; i++) {
+    w.m[i] = jobs[i].m, w.size[i] = jobs[i].size, w.out[i] = &w.digests[i << 3];
+    bytes += w.size[i];
+  }
+
+  streebog_batch(jobs.front().mode, k, w.m.data(), w.size.data(), w.out.data());
+  w.bytes.fetch_add(bytes, std::memory_order_relaxed);
+  for (ui64 i{}; i < k; i++)
+    if (jobs[i].cb) jobs[i].cb(0, w.out[i]);
+}
+
+void HashService::hash_buffer(Job& job, Worker& w) {
+  auto& stream = (job.mode == Streebog::Mode::H512 ? w.stream512 : w.stream256);
+  alignas(32) uint8_t digest[64];
+  stream.reset();
+  stream.update(job.m, job.size);
+  stream.finalize(digest);
+  w.bytes.fetch_add(job.size, std::memory_order_relaxed);
+  if (job.cb) job.cb(0, digest);
+}
+
+void HashService::hash_fd(Job& job, Worker& w, uint8_t* buff) {
+  if (!buff) {
+    if (job.cb) job.cb(ENOMEM, nullptr);
+    return;
+  }
+  auto& stream = (job.mode == Streebog::Mode::H512 ? w.stream512 : w.stream256);
+  stream.reset();
+  alignas(32) uint8_t digest[64];
+  ui64 bytes{};
+
+  for (;;) {
+    auto n = read(job.fd, buff, cfg.read_size);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) {
+      if (job.cb) job.cb(errno, nullptr);
+      return;
+    }
+    if (!n) break;
+    stream.update(buff, n);
+    bytes += n;
+  }
+
+  stream.finalize(digest);
+  w.bytes.fetch_add(bytes, std::memory_order_relaxed);
+  if (job.cb) job.cb(0, digest);
+}
+
+std::vector<HashService::WorkerStats> HashService::stats() const {
+  const double uptime = now_ns() - started_ns;
+  std::vector<WorkerStats> out;
+  for (auto& w : workers) {
+    WorkerStats s{w->jobs.load(std::memory_order_relaxed), w->bytes.load(std::memory_order_relaxed),
+                  w->busy_ns.load(std::memory_order_relaxed), 0.0};
+    s.utilization = (uptime > 0 ? s.busy_ns / uptime : 0.0);
+    out.push_back(s);
+  }
+
+  return out;
+}
@@ -0,0 +1,507 @@
+/**
+ * @file    store.cc
+ * @brief   Implementation of the content-addressed chunk store
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#include "store.hh"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+using ui64 = uint64_t;
+
+static constexpr char INDEX_MAGIC[8] = {'s', 't', 'b', 'g', 'i', 'd', 'x', '1'};
+static constexpr ui64 HEADER_SIZE = 64;     ///< the index slots start at this offset
+static constexpr ui64 CHUNK_HEADER = 36;    ///< size and digest in front of every chunk in a packfile
+static constexpr ui64 SEGMENT = 1ULL << 23;  ///< min bytes chunked and hashed as one unit of put()
+static constexpr ui64 PACK_BUFFER = 1ULL << 22;
+
+/**
+ * @brief gear table: 256 random 64-bit values (splitmix64 of a fixed seed)
+ */
+static constexpr auto GEAR = [] {
+  std::array<ui64, 256> t{};
+  ui64 x = 0x5354524545424F47ULL;
+  for (auto& v : t) {
+    ui64 z = (x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    v = z ^ (z >> 31);
+  }
+  return t;
+}();
+
+/**
+ * @brief index file header, in the byte order of the machine
+ */
+struct ChunkStore::Header {
+  char magic[8];
+  ChunkerConfig chunker;
+  uint32_t packs;  ///< number of packfiles
+  uint64_t capacity, count;
+  uint32_t dirty;  ///< entries were added after the last flush(), some may point past the end of their packfile
+  uint8_t reserved[HEADER_SIZE - 44];
+};
+
+struct ChunkStore::Slot {
+  uint8_t digest[32];
+  uint64_t offset;  ///< of the data in the packfile
+  uint32_t pack;
+  uint32_t size;  ///< 0 - empty slot
+};
+
+/**
+ * @brief a part of the file going through put(): read and chunked, then hashed, then stored
+ */
+struct ChunkStore::Segment {
+  std::vector<uint8_t> data;
+  std::vector<ChunkRef> chunks;
+  int err;
+  bool last, hashed;
+};
+
+uint64_t cdc_cut(uint8_t const* p, const uint64_t size, ChunkerConfig const& cfg) {
+  if (size <= cfg.min) return size;
+  const ui64 end = (size < cfg.max ? size : cfg.max), normal = (end < cfg.avg ? end : cfg.avg);
+
+  // one bit more than log2(avg) before the normal size, one bit less after it; the top bits of fp are the ones
+  // that have seen the most bytes
+  ui64 bits{};
+  while ((2ULL << bits) <= cfg.avg) bits++;
+  const ui64 strict = ~0ULL << (63 - bits), loose = ~0ULL << (65 - bits);
+
+  ui64 fp{}, i = cfg.min;
+  for (; i < normal; i++)
+    if (!((fp = (fp << 1) + GEAR[p[i]]) & strict)) return i + 1;
+  for (; i < end; i++)
+    if (!((fp = (fp << 1) + GEAR[p[i]]) & loose)) return i + 1;
+  return end;
+}
+
+static int read_full(const int fd, uint8_t* p, const ui64 size, ui64& got) {
+  got = 0;
+  while (got < size) {
+    auto n = read(fd, p + got, size - got);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) return errno;
+    if (!n) break;
+    got += n;
+  }
+  return 0;
+}
+
+static int write_full(const int fd, uint8_t const* p, ui64 size) {
+  while (size) {
+    auto n = write(fd, p, size);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) return errno;
+    p += n, size -= n;
+  }
+  return 0;
+}
+
+static ui64 slot_of(uint8_t const* digest, const ui64 capacity) {
+  ui64 h;
+  memcpy(&h, digest, 8);  // the digest is uniform already
+  return h & (capacity - 1);
+}
+
+static std::string pack_name(std::string const& dir, const uint32_t pack) {
+  char name[32];
+  snprintf(name, sizeof(name), "/pack-%08u", pack);
+  return dir + name;
+}
+
+ChunkStore::ChunkStore(char const* _dir, Config const& _cfg) : dir{_dir}, cfg{_cfg} {
+  if (mkdir(dir.c_str(), 0777) && errno != EEXIST) {
+    err = errno;
+    return;
+  }
+  const int fd = open((dir + "/index").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st)) {
+    err = errno;
+    if (fd >= 0) close(fd);
+    return;
+  }
+
+  if (!st.st_size) {  // a new store
+    auto& c = cfg.chunker;
+    if (c.avg < 64 || (c.avg & (c.avg - 1)) || c.min > c.avg || c.avg > c.max) {
+      err = EINVAL;
+      close(fd);
+      return;
+    }
+    ui64 capacity = 16;
+    while (capacity < cfg.index_capacity) capacity <<= 1;
+    Header h{};
+    memcpy(h.magic, INDEX_MAGIC, 8);
+    h.chunker = c, h.capacity = capacity;
+    if (ftruncate(fd, HEADER_SIZE + capacity * sizeof(Slot)) || pwrite(fd, &h, sizeof(h), 0) != sizeof(h)) {
+      err = errno;
+      close(fd);
+      return;
+    }
+  }
+
+  if ((err = map_index(fd))) return;
+  auto& c = index->chunker;
+  if (memcmp(index->magic, INDEX_MAGIC, 8) || !index->capacity || (index->capacity & (index->capacity - 1)) ||
+      index_sz != HEADER_SIZE + index->capacity * sizeof(Slot) || c.avg < 64 || (c.avg & (c.avg - 1)) ||
+      c.min > c.avg || c.avg > c.max) {
+    err = EBADMSG;
+    return;
+  }
+  cfg.chunker = c;
+
+  // the last packfile is the one appended to; the others are opened on demand
+  packs.assign(index->packs, -1);
+  if (index->packs) {
+    const int last = open(pack_name(dir, index->packs - 1).c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0666);
+    if (last < 0 || fstat(last, &st)) {
+      err = errno;
+      if (last >= 0) close(last);
+      return;
+    }
+    packs.back() = last, pack_len = st.st_size;
+  }
+
+  if (index->dirty) err = recover();  // not flushed before the last close: a crash may have lost packfile data
+}
+
+ChunkStore::~ChunkStore() {
+  if (index) flush(), munmap(index, index_sz);
+  if (index_fd >= 0) close(index_fd);
+  for (auto fd : packs)
+    if (fd >= 0) close(fd);
+}
+
+int ChunkStore::map_index(const int fd) {
+  struct stat st;
+  if (fstat(fd, &st)) return errno;
+  if ((ui64)st.st_size < HEADER_SIZE) {
+    close(fd);
+    return EBADMSG;
+  }
+  void* p = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED) {
+    const int e = errno;
+    close(fd);
+    return e;
+  }
+  if (index) munmap(index, index_sz);
+  if (index_fd >= 0) close(index_fd);
+  index = (Header*)p, index_sz = st.st_size, index_fd = fd;
+  return 0;
+}
+
+ChunkStore::Slot const* ChunkStore::find(uint8_t const* digest) const {
+  auto slots = (Slot*)(index + 1);
+  const ui64 mask = index->capacity - 1;
+  for (ui64 i = slot_of(digest, index->capacity); slots[i].size; i = (i + 1) & mask)
+    if (!memcmp(slots[i].digest, digest, 32)) return &slots[i];
+
+  ui64 h;
+  memcpy(&h, digest, 8);
+  for (auto [it, end] = pending_at.equal_range(h); it != end; it++)
+    if (!memcmp(pending[it->second].digest, digest, 32)) return &pending[it->second];
+  return nullptr;
+}
+
+bool ChunkStore::contains(uint8_t const* digest) const { return !err && find(digest); }
+
+uint64_t ChunkStore::size() const { return (err ? 0 : index->count + pending.size()); }
+
+int ChunkStore::recover() {
+  std::vector<ui64> len(index->packs);
+  for (uint32_t p{}; p < index->packs; p++) {
+    struct stat st;
+    len[p] = (stat(pack_name(dir, p).c_str(), &st) ? 0 : st.st_size);
+  }
+
+  auto slots = (Slot*)(index + 1);
+  std::vector<Slot> kept;
+  for (ui64 k{}; k < index->capacity; k++)
+    if (slots[k].size && slots[k].pack < len.size() && slots[k].offset + slots[k].size <= len[slots[k].pack])
+      kept.push_back(slots[k]);
+
+  if (kept.size() != index->count) {  // the table is rebuilt, probe sequences may not have holes
+    memset((void*)slots, 0, index->capacity * sizeof(Slot));
+    index->count = 0;
+    for (auto& s : kept)
+      if (int e = insert(s)) return e;
+  }
+  if (msync(index, index_sz, MS_SYNC)) return errno;
+  index->dirty = 0;
+  return (msync(index, HEADER_SIZE, MS_SYNC) ? errno : 0);
+}
+
+int ChunkStore::grow() {
+  // the doubled table is built in a new file and renamed over the old one, so a crash leaves one of them whole
+  const std::string path = dir + "/index", tmp = dir + "/index.tmp";
+  const ui64 capacity = index->capacity * 2;
+  const int fd = open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+  if (fd < 0) return errno;
+  if (ftruncate(fd, HEADER_SIZE + capacity * sizeof(Slot))) {
+    const int e = errno;
+    close(fd), unlink(tmp.c_str());
+    return e;
+  }
+  auto p = (Header*)mmap(nullptr, HEADER_SIZE + capacity * sizeof(Slot), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED) {
+    const int e = errno;
+    close(fd), unlink(tmp.c_str());
+    return e;
+  }
+
+  *p = *index, p->capacity = capacity;
+  auto from = (Slot*)(index + 1), to = (Slot*)(p + 1);
+  for (ui64 k{}; k < index->capacity; k++) {
+    if (!from[k].size) continue;
+    ui64 i = slot_of(from[k].digest, capacity);
+    while (to[i].size) i = (i + 1) & (capacity - 1);
+    to[i] = from[k];
+  }
+  const int e = (msync(p, HEADER_SIZE + capacity * sizeof(Slot), MS_SYNC) || rename(tmp.c_str(), path.c_str())
+                     ? errno
+                     : 0);
+  munmap(p, HEADER_SIZE + capacity * sizeof(Slot));
+  if (e) {
+    close(fd), unlink(tmp.c_str());
+    return e;
+  }
+  return map_index(fd);
+}
+
+int ChunkStore::insert(Slot const& s) {
+  if ((index->count + 1) * 10 > index->capacity * 7)
+    if (int e = grow()) return e;
+
+  auto slots = (Slot*)(index + 1);
+  ui64 i = slot_of(s.digest, index->capacity);
+  while (slots[i].size) i = (i + 1) & (index->capacity - 1);
+  slots[i] = s;
+  index->count++;
+  return 0;
+}
+
+int ChunkStore::flush_pack() {
+  if (pack_buf.empty()) return 0;
+  int e = write_full(packs.back(), pack_buf.data(), pack_buf.size());
+  pack_buf.clear();
+
+  // the index only points to data already in the packfile; the mark makes the next open check it if the data
+  // does not reach the disk
+  if (!e && !pending.empty() && !index->dirty) {
+    index->dirty = 1;
+    if (msync(index, HEADER_SIZE, MS_SYNC)) e = errno;
+  }
+  for (ui64 k{}; k < pending.size() && !e; k++) e = insert(pending[k]);
+  pending.clear(), pending_at.clear();
+  return e;
+}
+
+int ChunkStore::pack_fd(const uint32_t pack) {
+  if (packs[pack] < 0) packs[pack] = open(pack_name(dir, pack).c_str(), O_RDONLY | O_CLOEXEC);
+  return packs[pack];
+}
+
+int ChunkStore::append(uint8_t const* data, ChunkRef const& c) {
+  if (packs.empty() || (pack_len && pack_len + CHUNK_HEADER + c.size > cfg.pack_size)) {
+    if (int e = flush_pack()) return e;
+    if (!packs.empty() && fdatasync(packs.back())) return errno;  // flush() syncs the last packfile only
+    const int fd = open(pack_name(dir, packs.size()).c_str(), O_RDWR | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0666);
+    if (fd < 0) return errno;
+    if (!packs.empty() && packs.back() >= 0) close(packs.back()), packs.back() = -1;  // reopened read-only if needed
+    packs.push_back(fd), pack_len = 0;
+    index->packs = packs.size();
+  }
+
+  uint8_t head[CHUNK_HEADER];
+  memcpy(head, &c.size, 4), memcpy(head + 4, c.digest, 32);
+  pack_buf.insert(pack_buf.end(), head, head + CHUNK_HEADER);
+  pack_buf.insert(pack_buf.end(), data, data + c.size);
+  Slot s;
+  memcpy(s.digest, c.digest, 32);
+  s.offset = pack_len + CHUNK_HEADER, s.pack = packs.size() - 1, s.size = c.size;
+  ui64 h;
+  memcpy(&h, c.digest, 8);
+  pending_at.emplace(h, pending.size());
+  pending.push_back(s);
+  pack_len += CHUNK_HEADER + c.size;
+  return (pack_buf.size() >= PACK_BUFFER ? flush_pack() : 0);
+}
+
+int ChunkStore::put(const int fd, std::vector<ChunkRef>& recipe, StoreStats* stats) {
+  if (err) return err;
+  recipe.clear();
+  StoreStats st{};
+
+  ui64 threads = (cfg.threads ? cfg.threads : std::thread::hardware_concurrency());
+  threads = (threads ? threads : 1);
+  const ui64 depth = threads + 2, max = cfg.chunker.max;
+  const ui64 segment = (SEGMENT > 4 * max ? SEGMENT : 4 * max);
+
+  std::vector<Segment> ring(depth);
+  std::mutex mtx;
+  std::condition_variable reader_cv, worker_cv, writer_cv;
+  std::deque<ui64> todo;
+  ui64 produced{}, consumed{};
+  bool read_done{}, stop{};
+
+  // reader: fills a free segment, cuts it into chunks, leaves the bytes after the last cut to the next segment
+  std::thread reader([&] {
+    std::vector<uint8_t> carry;
+    for (bool last = false; !last;) {
+      std::unique_lock lk{mtx};
+      reader_cv.wait(lk, [&] { return produced - consumed < depth || stop; });
+      if (stop) break;
+      auto& s = ring[produced % depth];
+      lk.unlock();
+
+      s.data.resize(segment);
+      memcpy(s.data.data(), carry.data(), carry.size());
+      ui64 got;
+      s.err = read_full(fd, s.data.data() + carry.size(), segment - carry.size(), got);
+      const ui64 len = carry.size() + got;
+      last = (s.err || len < segment);
+
+      s.chunks.clear();
+      ui64 pos{};
+      while (!s.err && (len - pos >= max || (last && pos < len))) {
+        const ui64 n = cdc_cut(s.data.data() + pos, len - pos, cfg.chunker);
+        s.chunks.push_back({{}, (uint32_t)n});
+        pos += n;
+      }
+      carry.assign(s.data.begin() + pos, s.data.begin() + len);
+      s.last = last, s.hashed = false;
+
+      lk.lock();
+      todo.push_back(produced++);
+      worker_cv.notify_one();
+    }
+    std::lock_guard lk{mtx};
+    read_done = true;
+    worker_cv.notify_all();
+  });
+
+  // workers: all chunks of a segment go to the multi-lane kernel at once
+  std::vector<std::thread> workers;
+  for (ui64 t{}; t < threads; t++)
+    workers.emplace_back([&] {
+      std::vector<void const*> ptr;
+      std::vector<void*> out;
+      std::vector<ui64> size;
+      for (;;) {
+        std::unique_lock lk{mtx};
+        worker_cv.wait(lk, [&] { return !todo.empty() || read_done; });
+        if (todo.empty()) return;
+        auto& s = ring[todo.front() % depth];
+        todo.pop_front();
+        lk.unlock();
+
+        ptr.clear(), out.clear(), size.clear();
+        ui64 pos{};
+        for (auto& c : s.chunks) {
+          ptr.push_back(s.data.data() + pos), out.push_back(c.digest), size.push_back(c.size);
+          pos += c.size;
+        }
+        streebog_batch(Streebog::Mode::H256, s.chunks.size(), ptr.data(), size.data(), out.data());
+
+        lk.lock();
+        s.hashed = true;
+        writer_cv.notify_one();
+      }
+    });
+
+  // writer: segments in file order
+  int e{};
+  for (bool last = false; !last && !e;) {
+    std::unique_lock lk{mtx};
+    writer_cv.wait(lk, [&] { return consumed < produced && ring[consumed % depth].hashed; });
+    auto& s = ring[consumed % depth];
+    lk.unlock();
+
+    e = s.err, last = s.last;
+    ui64 pos{};
+    for (auto& c : s.chunks) {
+      if (e) break;
+      st.bytes += c.size, st.chunks++;
+      if (!find(c.digest)) {
+        e = append(s.data.data() + pos, c);
+        st.new_bytes += c.size, st.new_chunks++;
+      }
+      recipe.push_back(c);
+      pos += c.size;
+    }
+
+    lk.lock();
+    consumed++;
+    stop = (e != 0);
+    reader_cv.notify_one();
+  }
+
+  reader.join();
+  for (auto& t : workers) t.join();
+  if (e) return e;
+  if (stats) *stats = st;
+  return 0;
+}
+
+int ChunkStore::get(uint8_t const* digest, std::vector<uint8_t>& out) {
+  if (err) return err;
+  auto found = find(digest);
+  if (!found) return ENOENT;
+  const Slot slot = *found;  // flush_pack() moves the pending entries into the index
+  if (slot.pack + 1 == packs.size())
+    if (int e = flush_pack()) return e;
+  const int fd = pack_fd(slot.pack);
+  if (fd < 0) return errno;
+
+  out.resize(slot.size);
+  for (ui64 got{}; got < slot.size;) {
+    auto n = pread(fd, out.data() + got, slot.size - got, slot.offset + got);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) return errno;
+    if (!n) return EBADMSG;  // the packfile is shorter than the index says
+    got += n;
+  }
+
+  uint8_t check[32];
+  Streebog{Streebog::Mode::H256}(out.data(), out.size(), check);
+  return (memcmp(check, digest, 32) ? EBADMSG : 0);
+}
+
+int ChunkStore::restore(std::vector<ChunkRef> const& recipe, const int fd) {
+  std::vector<uint8_t> buf;
+  for (auto& c : recipe) {
+    if (int e = get(c.digest, buf)) return e;
+    if (int e = write_full(fd, buf.data(), buf.size())) return e;
+  }
+  return 0;
+}
+
+int ChunkStore::flush() {
+  if (err) return err;
+  if (int e = flush_pack()) return e;
+  if (!packs.empty() && fdatasync(packs.back())) return errno;
+  if (msync(index, index_sz, MS_SYNC)) return errno;
+  if (!index->dirty) return 0;
+  index->dirty = 0;  // only once both the data and the entries pointing to it are on the disk
+  return (msync(index, HEADER_SIZE, MS_SYNC) ? errno : 0);
+}
@@ -48,6 +48,14 @@ void Streebog::reset() {
 
 Streebog::Streebog(const Mode _mode) : mode{_mode} { this->reset(); }
 
+Streebog::Midstate Streebog::midstate() const {
+  Midstate s;
+  memcpy(s.h, h, 64), memcpy(s.n, n, 64), memcpy(s.sum, sum, 64);
+  return s;
+}
+
+void Streebog::resume(Midstate const& s) { memcpy(h, s.h, 64), memcpy(n, s.n, 64), memcpy(sum, s.sum, 64); }
+
 inline void vadd512(void* _a, void* _b, void* __restrict _dst) {
   ui64 *a = (ui64*)_a, *b = (ui64*)_b, *dst = (ui64*__restrict)_dst;
   bool carry{};
@@ -72,6 +80,36 @@ inline void LPSX(ui64 const* __restrict lhs, ui64 const* __restrict rhs, ui64* _
   } (make_is<64>());
 }
 
+inline void LPS(ui64 const* __restrict in, ui64* __restrict out) {
+  alignas(32) ui64 r[8];
+  [&]<ui64... I>(is<I...>) {
+    ((r[I] = in[I], out[I] = 0), ...);
+  } (make_is<8>());
+
+  [&]<ui64... I>(is<I...>) __attribute__((always_inline)) {
+    ((out[I >> 3] ^= mmul_lut[I & 7][(uint8_t)r[I & 7]],
+      r[I & 7] >>= 8), ...);
+  } (make_is<64>());
+}
+
+void Streebog::G_zero() {
+  alignas(32) ui64 K[8], tmp[8];
+  memcpy(K, h, 64);
+
+  LPSX(K, n, K);
+  LPS(K, tmp);  // X[K](0) = K
+  LPSX(K, C, K);
+
+  [&]<ui64... I>(is<I...>) {
+    ((LPSX(K, tmp, tmp),
+      LPSX(K, C + ((I + 1) << 3), K)), ...);
+  } (make_is<11>());
+
+  [&]<ui64... I>(is<I...>) __attribute__((always_inline)) {
+    ((h[I] ^= tmp[I] ^ K[I]), ...);
+  } (make_is<8>());
+}
+
 void Streebog::G(ui64 const* __restrict m, bool is_zero) {
   alignas(32) ui64 K[8], tmp[8], zeros[8]{};
   memcpy(K, h, 64);
@@ -92,6 +130,63 @@ void Streebog::G(ui64 const* __restrict m, bool is_zero) {
   } (make_is<8>());
 }
 
+/**
+ * @brief G transformation of L independent states at once
+ * @details every round is issued for all lanes before the next one, so the table lookups of different lanes
+ * overlap instead of waiting on a single dependency chain
+ */
+template <ui64 L>
+inline void G_lanes(ui64* const* __restrict h, ui64 const* const* __restrict n, ui64 const* const* __restrict m) {
+  alignas(32) ui64 K[L][8], tmp[L][8];
+  [&]<ui64... J>(is<J...>) __attribute__((always_inline)) {
+    ((memcpy(K[J], h[J], 64)), ...);
+    ((LPSX(K[J], n[J], K[J])), ...);
+    ((LPSX(K[J], m[J], tmp[J])), ...);
+    ((LPSX(K[J], C, K[J])), ...);
+
+    [&]<ui64... I>(is<I...>) __attribute__((always_inline)) {
+      ([&](const ui64 r) __attribute__((always_inline)) {
+         ((LPSX(K[J], tmp[J], tmp[J])), ...);
+         ((LPSX(K[J], C + ((r + 1) << 3), K[J])), ...);
+       }(I), ...);
+    } (make_is<11>());
+
+    ([&](const ui64 j) __attribute__((always_inline)) {
+       [&]<ui64... I>(is<I...>) __attribute__((always_inline)) {
+         ((h[j][I] ^= tmp[j][I] ^ K[j][I] ^ m[j][I]), ...);
+       } (make_is<8>());
+     }(J), ...);
+  } (make_is<L>());
+}
+
+template <ui64 L>
+inline void update_lanes_impl(void const* const* m, ui64* const* h, ui64* const* n, ui64* const* sum,
+                              const ui64 size) {
+  ui64 const* blk[L];
+  for (ui64 i{}; i < (size >> 6); i++) {
+    for (ui64 j{}; j < L; j++) blk[j] = (ui64 const*)m[j] + (i << 3);
+    G_lanes<L>(h, (ui64 const* const*)n, blk);
+    for (ui64 j{}; j < L; j++) {
+      vadd512(sum[j], (void*)blk[j], sum[j]);
+      *n[j] += 0x200;
+    }
+  }
+}
+
+void Streebog::update_lanes(Streebog* const* ctx, void const* const* m, const ui64 count, const ui64 size) {
+  ui64 i{};
+  auto run = [&]<ui64 L>(std::integral_constant<ui64, L>) {
+    ui64 *h[L], *n[L], *sum[L];
+    for (ui64 j{}; j < L; j++) h[j] = ctx[i + j]->h, n[j] = ctx[i + j]->n, sum[j] = ctx[i + j]->sum;
+    update_lanes_impl<L>(m + i, h, n, sum, size);
+    i += L;
+  };
+
+  while (count - i >= LANES) run(std::integral_constant<ui64, LANES>{});
+  if (count - i >= 2) run(std::integral_constant<ui64, 2>{});
+  if (count - i == 1) ctx[i]->update((void*)m[i], size);
+}
+
 void Streebog::update(void* __restrict m, const ui64 size) {
   for (ui64 i{}; i < (size >> 6); i++) {
     G((ui64*)m + (i << 3));
@@ -100,6 +195,13 @@ void Streebog::update(void* __restrict m, const ui64 size) {
   }
 }
 
+void Streebog::update_zeros(const ui64 blocks) {
+  for (ui64 i{}; i < blocks; i++) {
+    G_zero();
+    *(uint64_t*)n += 0x200;
+  }
+}
+
 ui64 const* const Streebog::finalize(void* __restrict m, const ui64 size) {
   alignas(32) uint64_t buff[8]{};
   const ui64 _d = size & ~0x3FULL;
@@ -125,3 +227,112 @@ ui64 const* const Streebog::operator()(void* m, const ui64 size, void* out) {
 
   return ret;
 }
+
+StreebogStream::StreebogStream(const Streebog::Mode _mode) : ctx{_mode} {}
+
+void StreebogStream::reset() {
+  ctx.reset();
+  buff_sz = 0;
+}
+
+/**
+ * @brief whole-block update of the context(s) behind a buffered stream
+ */
+static void update_blocks(Streebog& ctx, void const* m, const ui64 size) { ctx.update((void*)m, size); }
+
+static void update_blocks(Streebog* const (&ctx)[2], void const* m, const ui64 size) {
+  void const* ptr[] = {m, m};
+  Streebog::update_lanes(ctx, ptr, 2, size);
+}
+
+/**
+ * @brief appends a chunk of any size: completes the buffered block, passes the whole blocks on and keeps the tail
+ */
+template <typename Ctx>
+static void update_buffered(Ctx& ctx, uint8_t* buff, ui64& buff_sz, void const* _m, const ui64 size) {
+  auto m = (uint8_t const*)_m;
+  auto left = size;
+  if (buff_sz) {
+    auto n = (64 - buff_sz < left ? 64 - buff_sz : left);
+    memcpy(buff + buff_sz, m, n);
+    buff_sz += n, m += n, left -= n;
+    if (buff_sz < 64) return;
+    update_blocks(ctx, buff, 64);
+    buff_sz = 0;
+  }
+
+  const ui64 _d = left & ~0x3FULL;
+  update_blocks(ctx, m, _d);
+  memcpy(buff, m + _d, left - _d);
+  buff_sz = left - _d;
+}
+
+void StreebogStream::update(void const* m, const ui64 size) { update_buffered(ctx, buff, buff_sz, m, size); }
+
+void StreebogStream::update_zeros(const ui64 size) {
+  auto left = size;
+  if (buff_sz) {
+    auto n = (64 - buff_sz < left ? 64 - buff_sz : left);
+    memset(buff + buff_sz, 0, n);
+    buff_sz += n, left -= n;
+    if (buff_sz < 64) return;
+    ctx.update(buff, 64);
+    buff_sz = 0;
+  }
+
+  ctx.update_zeros(left >> 6);
+  memset(buff, 0, left & 0x3F);
+  buff_sz = left & 0x3F;
+}
+
+void StreebogStream::finalize(void* out) { ctx(buff, buff_sz, out); }
+
+void StreebogStream::digest(void* out) const {
+  StreebogStream tmp{*this};
+  tmp.finalize(out);
+}
+
+void streebog_batch(const Streebog::Mode mode, const ui64 count, void const* const* m, ui64 const* size,
+                    void* const* out) {
+  for (ui64 i{}; i < count; i += Streebog::LANES) {
+    const ui64 k = (count - i < Streebog::LANES ? count - i : Streebog::LANES);
+    auto ctx = [&]<ui64... J>(is<J...>) {
+      return std::array<Streebog, Streebog::LANES>{((void)J, Streebog{mode})...};
+    } (make_is<Streebog::LANES>());
+    ui64 off[Streebog::LANES]{};
+
+    for (;;) {  // advance the lanes having whole blocks left by the shortest of them
+      Streebog* act[Streebog::LANES];
+      void const* ptr[Streebog::LANES];
+      ui64 n{}, step = ~0ULL;
+      for (ui64 j{}; j < k; j++) {
+        auto left = (size[i + j] - off[j]) & ~0x3FULL;
+        if (!left) continue;
+        act[n] = &ctx[j], ptr[n++] = (uint8_t const*)m[i + j] + off[j];
+        step = (left < step ? left : step);
+      }
+      if (!n) break;
+
+      Streebog::update_lanes(act, ptr, n, step);
+      for (ui64 j{}; j < k; j++)
+        if (size[i + j] - off[j] >= 64) off[j] += step;
+    }
+
+    for (ui64 j{}; j < k; j++) ctx[j]((uint8_t*)m[i + j] + off[j], size[i + j] - off[j], out[i + j]);
+  }
+}
+
+void StreebogDual::reset() {
+  h512.reset(), h256.reset();
+  buff_sz = 0;
+}
+
+void StreebogDual::update(void const* m, const ui64 size) {
+  Streebog* const ctx[] = {&h512, &h256};
+  update_buffered(ctx, buff, buff_sz, m, size);
+}
+
+void StreebogDual::finalize(void* out512, void* out256) {
+  h512(buff, buff_sz, out512);
+  h256(buff, buff_sz, out256);
+}
@@ -0,0 +1,156 @@
+/**
+ * @file    accumulator_test.cc
+ * @brief   Tests of the append-only Merkle accumulator
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "accumulator.hh"
+#include "doctest.h"
+
+namespace {
+  using Hash = std::vector<uint8_t>;
+
+  Hash H(std::vector<uint8_t> const& m) {
+    Hash d(32);
+    uint8_t empty[1];
+    Streebog{Streebog::Mode::H256}((m.empty() ? empty : (uint8_t*)m.data()), m.size(), d.data());
+    return d;
+  }
+
+  std::string entry(const uint64_t i) { return "entry #" + std::to_string(i) + std::string(i % 100, 'x'); }
+
+  /**
+   * @brief MTH(D[lo:hi]) exactly as written in RFC 6962, 2.1
+   */
+  Hash mth(const uint64_t lo, const uint64_t hi) {
+    if (hi == lo) return H({});
+    if (hi - lo == 1) {
+      auto e = entry(lo);
+      std::vector<uint8_t> m{0x00};
+      m.insert(m.end(), e.begin(), e.end());
+      return H(m);
+    }
+    uint64_t k = 1;
+    while (2 * k < hi - lo) k *= 2;
+    std::vector<uint8_t> m{0x01};
+    auto l = mth(lo, lo + k), r = mth(lo + k, hi);
+    m.insert(m.end(), l.begin(), l.end());
+    m.insert(m.end(), r.begin(), r.end());
+    return H(m);
+  }
+
+  void append(MerkleAccumulator& acc, const uint64_t count) {
+    std::vector<std::string> e;
+    std::vector<void const*> ptr;
+    std::vector<uint64_t> size;
+    for (uint64_t i{}; i < count; i++) e.push_back(entry(acc.size() + i));
+    for (auto& s : e) ptr.push_back(s.data()), size.push_back(s.size());
+    acc.append(count, ptr.data(), size.data());
+  }
+}  // namespace
+
+TEST_SUITE("accumulator") {
+  TEST_CASE("roots are those of RFC 6962 whatever the batches") {
+    MerkleAccumulator acc, one_by_one;
+    Hash r(32);
+    acc.root(r.data());
+    CHECK(r == mth(0, 0));
+
+    for (uint64_t batch : {1, 1, 5, 1, 8, 17, 3, 1, 32}) {
+      append(acc, batch);
+      for (uint64_t i{}; i < batch; i++) append(one_by_one, 1);
+      acc.root(r.data());
+      CHECK(r == mth(0, acc.size()));
+      Hash r1(32);
+      one_by_one.root(r1.data());
+      CHECK(r1 == r);
+    }
+    for (uint64_t n{}; n <= acc.size(); n++) {
+      REQUIRE(acc.root(n, r.data()) == 0);
+      CHECK(r == mth(0, n));
+    }
+    CHECK(acc.root(acc.size() + 1, r.data()) == EINVAL);
+
+    auto e = entry(7);
+    Hash leaf(32), stored(32);
+    MerkleAccumulator::leaf_hash(e.data(), e.size(), leaf.data());
+    REQUIRE(acc.leaf(7, stored.data()) == 0);
+    CHECK(leaf == stored);
+    CHECK(leaf == mth(7, 8));
+  }
+
+  TEST_CASE("inclusion proofs") {
+    MerkleAccumulator acc;
+    append(acc, 35);
+    std::vector<uint8_t> proof;
+    Hash root(32), leaf(32);
+    for (uint64_t n = 1; n <= 35; n++) {
+      acc.root(n, root.data());
+      for (uint64_t i{}; i < n; i++) {
+        REQUIRE(acc.prove_inclusion(i, n, proof) == 0);
+        acc.leaf(i, leaf.data());
+        CHECK(MerkleAccumulator::verify_inclusion(leaf.data(), i, n, root.data(), proof.data(), proof.size()));
+
+        if (n > 1) {
+          CHECK(!MerkleAccumulator::verify_inclusion(leaf.data(), (i + 1) % n, n, root.data(), proof.data(),
+                                                     proof.size()));
+          proof[0] ^= 1;
+          CHECK(!MerkleAccumulator::verify_inclusion(leaf.data(), i, n, root.data(), proof.data(), proof.size()));
+          CHECK(!MerkleAccumulator::verify_inclusion(leaf.data(), i, n, root.data(), proof.data(), proof.size() - 32));
+        }
+      }
+    }
+    CHECK(acc.prove_inclusion(5, 5, proof) == EINVAL);
+    CHECK(acc.prove_inclusion(0, 36, proof) == EINVAL);
+  }
+
+  TEST_CASE("consistency proofs") {
+    MerkleAccumulator acc;
+    append(acc, 35);
+    std::vector<uint8_t> proof;
+    Hash old_root(32), new_root(32);
+    for (uint64_t n = 1; n <= 35; n++) {
+      acc.root(n, new_root.data());
+      for (uint64_t m = 1; m <= n; m++) {
+        acc.root(m, old_root.data());
+        REQUIRE(acc.prove_consistency(m, n, proof) == 0);
+        CHECK(MerkleAccumulator::verify_consistency(m, n, old_root.data(), new_root.data(), proof.data(),
+                                                    proof.size()));
+        if (m == n) {
+          CHECK(proof.empty());
+          continue;
+        }
+        CHECK(!MerkleAccumulator::verify_consistency(m, n, new_root.data(), new_root.data(), proof.data(),
+                                                     proof.size()));
+        proof.back() ^= 1;
+        CHECK(!MerkleAccumulator::verify_consistency(m, n, old_root.data(), new_root.data(), proof.data(),
+                                                     proof.size()));
+      }
+    }
+    CHECK(acc.prove_consistency(0, 3, proof) == EINVAL);
+    CHECK(acc.prove_consistency(4, 3, proof) == EINVAL);
+  }
+
+  TEST_CASE("the right edge of the current tree") {
+    // 1000 = 512 + 256 + 128 + 64 + 32 + 8: the last entry has three siblings in its subtree of 8 and one per
+    // larger subtree; the first one has the incomplete right half of the tree as its last sibling
+    MerkleAccumulator acc;
+    append(acc, 1000);
+    std::vector<uint8_t> proof;
+    REQUIRE(acc.prove_inclusion(999, 1000, proof) == 0);
+    CHECK(proof.size() == 32 * 8);
+
+    auto expected = mth(512, 1000);
+    REQUIRE(acc.prove_inclusion(0, 1000, proof) == 0);
+    CHECK(Hash(proof.end() - 32, proof.end()) == expected);
+  }
+}
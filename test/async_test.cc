@@ -0,0 +1,117 @@
+/**
+ * @file    async_test.cc
+ * @brief   Tests of the coroutine interface
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#include <string.h>
+
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include "async.hh"
+#include "doctest.h"
+
+namespace {
+  struct Loop {
+    std::deque<std::function<void()>> q;
+    void post(std::function<void()> f) { q.push_back(std::move(f)); }
+    uint64_t run() {
+      uint64_t n{};
+      for (; !q.empty(); n++) {
+        auto f = std::move(q.front());
+        q.pop_front();
+        f();
+      }
+      return n;
+    }
+  };
+
+  struct Detached {
+    struct promise_type {
+      Detached get_return_object() { return {}; }
+      std::suspend_never initial_suspend() noexcept { return {}; }
+      std::suspend_never final_suspend() noexcept { return {}; }
+      void return_void() {}
+      void unhandled_exception() {}
+    };
+  };
+
+  Detached hash_on(AsyncStreebog& s, std::span<uint8_t const> m, Loop& work, Loop& home, uint8_t* out, bool& done) {
+    co_await s.update_async(m.first(100), work, home, 64);
+    co_await s.update_async(m.subspan(100), work, home, 1024);
+    s.finalize(out);
+    done = true;
+  }
+
+  Detached hash_in_slices(AsyncStreebog& s, std::span<uint8_t const> m, Loop& loop, uint8_t* out, bool& done,
+                          const uint64_t slice = 256) {
+    co_await s.update_async(m, loop, slice);
+    s.finalize(out);
+    done = true;
+  }
+}  // namespace
+
+TEST_SUITE("async") {
+  TEST_CASE("sliced hashing interleaves with other work on the loop") {
+    std::vector<uint8_t> data(5000);
+    for (uint64_t i{}; i < data.size(); i++) data[i] = (uint8_t)(i * 7);
+
+    uint8_t expected[64], out[64];
+    Streebog{Streebog::Mode::H512}(data.data(), data.size(), expected);
+
+    Loop loop;
+    AsyncStreebog s{Streebog::Mode::H512};
+    bool done{};
+    hash_in_slices(s, data, loop, out, done);
+    REQUIRE(!done);
+
+    uint64_t others{};
+    loop.post([&] { others += !done; });
+    REQUIRE(loop.run() == 5000 / 256 + 1 + 1);
+    REQUIRE(done);
+    REQUIRE(others == 1);
+    REQUIRE(memcmp(expected, out, 64) == 0);
+  }
+
+  TEST_CASE("offloaded hashing resumes on the home executor") {
+    std::vector<uint8_t> data(3000, 0x5a);
+    uint8_t expected[32], out[32];
+    Streebog{Streebog::Mode::H256}(data.data(), data.size(), expected);
+
+    Loop work, home;
+    AsyncStreebog s{Streebog::Mode::H256};
+    bool done{};
+    hash_on(s, data, work, home, out, done);
+
+    work.run();
+    REQUIRE(!done);
+    home.run();
+    REQUIRE(!done);
+    work.run();
+    home.run();
+    REQUIRE(done);
+    REQUIRE(memcmp(expected, out, 32) == 0);
+  }
+
+  TEST_CASE("degenerate slices still make progress") {
+    std::vector<uint8_t> data(1000, 0x33);
+    uint8_t expected[64], out[64];
+    Streebog{Streebog::Mode::H512}(data.data(), data.size(), expected);
+
+    // 0 is one block per job, the largest size is the whole data in one job
+    for (auto [slice, jobs] : {std::pair<uint64_t, uint64_t>{0, 16}, {~0ULL, 1}, {~0ULL - 10, 1}}) {
+      Loop loop;
+      AsyncStreebog s{Streebog::Mode::H512};
+      bool done{};
+      hash_in_slices(s, data, loop, out, done, slice);
+      REQUIRE(loop.run() == jobs);
+      REQUIRE(done);
+      REQUIRE(memcmp(expected, out, 64) == 0);
+    }
+  }
+}
@@ -0,0 +1,128 @@
+/**
+ * @file    cache_test.cc
+ * @brief   Tests of the --cache of the stbg utility
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/xattr.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "../tool/stbg.hh"
+#include "doctest.h"
+#include "test_util.hh"
+
+namespace {
+  constexpr char const* ATTR = "user.streebog.256";
+
+  std::vector<uint8_t> digest_of(std::vector<uint8_t> const& data) {
+    std::vector<uint8_t> d(32);
+    Streebog{Streebog::Mode::H256}((void*)data.data(), data.size(), d.data());
+    return d;
+  }
+
+  /**
+   * @brief hash_fd_cached() of the whole file
+   */
+  std::vector<uint8_t> cached(const int fd, Options const& opt) {
+    std::vector<uint8_t> d(32);
+    lseek(fd, 0, SEEK_SET);
+    REQUIRE(hash_fd_cached(fd, Streebog::Mode::H256, d.data(), opt) == 0);
+    return d;
+  }
+
+  std::string attr(const int fd) {
+    char value[256];
+    const auto n = fgetxattr(fd, ATTR, value, sizeof(value));
+    return (n > 0 ? std::string(value, n) : std::string{});
+  }
+}  // namespace
+
+TEST_SUITE("cache") {
+  TEST_CASE("attribute hits, misses and stale entries") {
+    std::vector<uint8_t> data(100000, 0x42);
+    TempFile f{data};
+    if (fsetxattr(f.fd, "user.stbg_probe", "", 0, 0)) {
+      MESSAGE("no user xattrs on /tmp: ", strerror(errno));
+      return;
+    }
+
+    DigestCache cache{nullptr};
+    Options opt{.mode = Streebog::Mode::H256, .prog = "stbg"};
+    opt.cache = &cache;
+
+    // miss: nothing stored yet, the file is hashed and the digest stored
+    struct stat st;
+    uint8_t d[32];
+    REQUIRE(fstat(f.fd, &st) == 0);
+    CHECK(!cache.lookup(f.fd, st, Streebog::Mode::H256, d));
+    CHECK(cached(f.fd, opt) == digest_of(data));
+    auto value = attr(f.fd);
+    REQUIRE(value.substr(0, 3) == "v2 ");
+
+    // hit: the digest comes from the attribute, not from the data
+    auto forged = value.substr(0, value.size() - 64) + std::string(64, '0');
+    REQUIRE(fsetxattr(f.fd, ATTR, forged.data(), forged.size(), 0) == 0);
+    REQUIRE(fstat(f.fd, &st) == 0);
+    CHECK(cache.lookup(f.fd, st, Streebog::Mode::H256, d));
+    CHECK(cached(f.fd, opt) == std::vector<uint8_t>(32, 0));
+
+    // stale: the contents are rewritten with the same size
+    data[500] ^= 1;
+    REQUIRE(pwrite(f.fd, data.data(), data.size(), 0) == (ssize_t)data.size());
+    timespec times[2] = {{0, UTIME_OMIT}, {st.st_mtim.tv_sec + 1, st.st_mtim.tv_nsec}};
+    REQUIRE(futimens(f.fd, times) == 0);  // coarse timestamps may not tell the writes apart by themselves
+    REQUIRE(fstat(f.fd, &st) == 0);
+    CHECK(!cache.lookup(f.fd, st, Streebog::Mode::H256, d));
+    CHECK(cached(f.fd, opt) == digest_of(data));
+    CHECK(attr(f.fd) != value);
+
+    // stale: the file has grown
+    data.push_back(1);
+    REQUIRE(pwrite(f.fd, data.data(), data.size(), 0) == (ssize_t)data.size());
+    REQUIRE(fstat(f.fd, &st) == 0);
+    CHECK(!cache.lookup(f.fd, st, Streebog::Mode::H256, d));
+    CHECK(cached(f.fd, opt) == digest_of(data));
+
+    // values of the older format with a ctime field are not trusted
+    const std::string v1 = "v1 1 2 3 4 " + std::string(64, '0');
+    REQUIRE(fsetxattr(f.fd, ATTR, v1.data(), v1.size(), 0) == 0);
+    REQUIRE(fstat(f.fd, &st) == 0);
+    CHECK(!cache.lookup(f.fd, st, Streebog::Mode::H256, d));
+  }
+
+  TEST_CASE("sidecar database entries are matched by ctime") {
+    std::vector<uint8_t> data(1000, 0x17);
+    TempFile f{data}, db{{}};
+    struct stat st;
+    REQUIRE(fstat(f.fd, &st) == 0);
+
+    char line[512];
+    const int n = snprintf(line, sizeof(line), "%llu %llu %llu %llu %llu 256 %s\n", (unsigned long long)st.st_dev,
+                           (unsigned long long)st.st_ino, (unsigned long long)st.st_size,
+                           (unsigned long long)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec,
+                           (unsigned long long)st.st_ctim.tv_sec * 1000000000 + st.st_ctim.tv_nsec,
+                           std::string(64, 'a').c_str());
+    REQUIRE(pwrite(db.fd, line, n, 0) == n);
+
+    DigestCache cache{db.path.c_str()};
+    uint8_t d[32];
+    CHECK(cache.lookup(f.fd, st, Streebog::Mode::H256, d));
+    CHECK(std::vector<uint8_t>(d, d + 32) == std::vector<uint8_t>(32, 0xaa));
+    CHECK(!cache.lookup(f.fd, st, Streebog::Mode::H512, d));
+
+    st.st_ctim.tv_nsec ^= 1;  // e.g. chmod or a write with the mtime set back
+    CHECK(!cache.lookup(f.fd, st, Streebog::Mode::H256, d));
+  }
+}
@@ -0,0 +1,87 @@
+/**
+ * @file    delta_test.cc
+ * @brief   Tests of rsync-style signatures and deltas
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "delta.hh"
+#include "doctest.h"
+#include "test_util.hh"
+
+namespace {
+  /**
+   * @brief signature of basis, delta of next, patch; returns the stats of the delta
+   */
+  DeltaStats round_trip(std::vector<uint8_t> const& basis, std::vector<uint8_t> const& next, const uint32_t block) {
+    Temp b{basis}, n{next}, s, d, out;
+    Signature sig, sig2;
+    REQUIRE(make_signature(b.fd, block, 0, sig) == 0);
+    REQUIRE(write_signature(s.fd, sig) == 0);
+    lseek(s.fd, 0, SEEK_SET);
+    REQUIRE(read_signature(s.fd, sig2) == 0);
+    REQUIRE(sig2.weak == sig.weak);
+    REQUIRE(sig2.strong == sig.strong);
+
+    DeltaStats stats;
+    REQUIRE(make_delta(sig2, n.fd, d.fd, &stats) == 0);
+    lseek(d.fd, 0, SEEK_SET);
+    REQUIRE(apply_delta(b.fd, d.fd, out.fd) == 0);
+    REQUIRE(out.contents() == next);
+    REQUIRE(stats.copied + stats.literal == next.size());
+    return stats;
+  }
+}  // namespace
+
+TEST_SUITE("delta") {
+  TEST_CASE("edits of a file are found as copies of the basis") {
+    auto basis = noise(100000, 1);
+    auto next = basis;
+    next.insert(next.begin() + 30000, 777, 'x');                   // insertion
+    next.erase(next.begin() + 60000, next.begin() + 61000);        // deletion
+    for (int i{}; i < 10; i++) next[80000 + i] ^= 0xFF;            // change
+    next.insert(next.end(), basis.begin(), basis.begin() + 5000);  // moved data
+
+    auto stats = round_trip(basis, next, 1024);
+    CHECK(stats.literal < 8 * 1024);
+
+    CHECK(round_trip(basis, basis, 1024).literal == 0);          // unchanged, including the short last block
+    CHECK(round_trip(basis, basis, 0).literal == 0);
+    CHECK(round_trip(basis, noise(5000, 2), 1024).copied == 0);  // nothing in common
+    round_trip({}, next, 1024);                                  // empty basis
+    CHECK(round_trip(basis, {}, 1024).copied == 0);              // empty new file
+    round_trip(noise(100, 3), noise(100, 3), 1024);              // shorter than a block
+  }
+
+  TEST_CASE("patch refuses a wrong basis and a broken delta") {
+    auto basis = noise(20000, 4), other = noise(20000, 5), next = basis;
+    next[100] ^= 1;
+    Temp b{basis}, o{other}, n{next}, d, out;
+    Signature sig;
+    REQUIRE(make_signature(b.fd, 1024, 8, sig) == 0);
+    REQUIRE(make_delta(sig, n.fd, d.fd) == 0);
+
+    lseek(d.fd, 0, SEEK_SET);
+    CHECK(apply_delta(o.fd, d.fd, out.fd) == EBADMSG);
+
+    REQUIRE(ftruncate(d.fd, lseek(d.fd, 0, SEEK_END) - 1) == 0);
+    lseek(d.fd, 0, SEEK_SET);
+    CHECK(apply_delta(b.fd, d.fd, out.fd) == EBADMSG);
+
+    Temp junk{noise(100, 6)};
+    CHECK(read_signature(junk.fd, sig) == EBADMSG);
+    CHECK(make_signature(b.fd, 1024, 33, sig) == EINVAL);
+  }
+}
@@ -0,0 +1,62 @@
+/**
+ * @file    dupes_test.cc
+ * @brief   Tests of the --dupes mode of the stbg utility
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include "../tool/stbg.hh"
+#include "doctest.h"
+#include "test_util.hh"
+
+namespace {
+  std::string line(const int group, std::vector<uint8_t> const& data, std::string const& name) {
+    uint8_t d[32];
+    char hex[65];
+    Streebog{Streebog::Mode::H256}((void*)data.data(), data.size(), d);
+    digest_to_hex(d, Streebog::Mode::H256, hex);
+    std::string out = std::to_string(group);
+    out += '\t';
+    out += std::to_string(data.size());
+    out += '\t';
+    out += hex;
+    out += '\t';
+    out += name;
+    out += '\n';
+    return out;
+  }
+}  // namespace
+
+TEST_SUITE("dupes") {
+  TEST_CASE("only equal contents are grouped, hard links count once") {
+    TempDir d;
+    const auto big = noise(200 << 10, 1);  // longer than both edges: decided by the full hash
+    auto middle = big, head = big;
+    middle[100 << 10] ^= 1;  // same size and edges as big
+    head[0] ^= 1;            // same size, different head
+    const auto small = noise(1000, 2);
+
+    d.add("a", big), d.add("b", big), d.add("c", middle), d.add("d", head);
+    d.link_to("e", "a");
+    d.add("s\t1", small), d.add("s2", small);
+    d.add("u", noise(1000, 3));  // same size as the small ones
+    d.add("z", {});              // empty files are skipped
+
+    Options opt{.mode = Streebog::Mode::H512, .prog = "stbg"};
+    opt.threads = 2;
+    char const* roots[] = {d.path.c_str()};
+    int status = -1;
+    auto out = capture_stdout([&] { status = find_dupes(roots, 1, opt); });
+
+    CHECK(status == EXIT_SUCCESS);
+    CHECK(out == line(1, big, d.path + "/a") + line(1, big, d.path + "/b") + line(2, small, d.path + "/s\\t1") +
+                     line(2, small, d.path + "/s2"));
+  }
+}
@@ -0,0 +1,320 @@
+/**
+ * @file    file_test.cc
+ * @brief   Tests of hashing of files and file descriptors
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "doctest.h"
+#include "file.hh"
+#include "uring.hh"
+#include "test_util.hh"
+
+namespace {
+  std::vector<uint8_t> pattern(const uint64_t size) {
+    std::vector<uint8_t> v(size);
+    for (uint64_t i{}; i < size; i++) v[i] = (uint8_t)(i * 31 + (i >> 12));
+    return v;
+  }
+}  // namespace
+
+TEST_SUITE("files") {
+  TEST_CASE("every read method gives the one-shot hash") {
+    for (uint64_t size : {0ULL, 1ULL, 64ULL, 4096ULL, 5000ULL, (1ULL << 20) + 4096, (1ULL << 20) + 17}) {
+      auto data = pattern(size);
+      TempFile f{data};
+      uint8_t expected[64], out[64];
+      Streebog{Streebog::Mode::H512}(data.data(), size, expected);
+
+      for (auto m : {ReadMethod::Auto, ReadMethod::Read, ReadMethod::Mmap, ReadMethod::Direct, ReadMethod::Uring}) {
+        REQUIRE(hash_file(f.path.c_str(), Streebog::Mode::H512, out, m) == 0);
+        REQUIRE(memcmp(expected, out, 64) == 0);
+      }
+    }
+  }
+
+  TEST_CASE("pipelined reading with any depth and chunk") {
+    auto data = pattern((1ULL << 18) + 100);
+    TempFile f{data};
+    uint8_t expected[32], out[32];
+    Streebog{Streebog::Mode::H256}(data.data(), data.size(), expected);
+
+    for (uint64_t depth : {1, 2, 5})
+      for (uint64_t chunk : {1ULL, 4096ULL, 1ULL << 18, 1ULL << 20}) {
+        const int fd = open(f.path.c_str(), O_RDONLY);
+        REQUIRE(hash_fd_pipelined(fd, Streebog::Mode::H256, out, PipelineConfig{depth, chunk}) == 0);
+        close(fd);
+        REQUIRE(memcmp(expected, out, 32) == 0);
+      }
+  }
+
+  TEST_CASE("pipelined reading of an O_DIRECT fd up to an unaligned end") {
+    for (uint64_t size : {100ULL, 4096ULL, 4096ULL + 17, (1ULL << 18) + 100}) {
+      auto data = pattern(size);
+      TempFile f{data};
+      for (uint64_t start : {0ULL, 4096ULL}) {
+        if (start > size) continue;
+        const int fd = open(f.path.c_str(), O_RDONLY | O_DIRECT);
+        if (fd < 0) {
+          MESSAGE("no O_DIRECT on /tmp: ", strerror(errno));
+          return;
+        }
+        uint8_t expected[32], out[32];
+        Streebog{Streebog::Mode::H256}(data.data() + start, size - start, expected);
+        lseek(fd, start, SEEK_SET);
+        REQUIRE(hash_fd_pipelined(fd, Streebog::Mode::H256, out, PipelineConfig{2, 4096}) == 0);
+        close(fd);
+        REQUIRE(memcmp(expected, out, 32) == 0);
+      }
+    }
+  }
+
+  TEST_CASE("O_DIRECT body with unaligned head and tail") {
+    for (uint64_t size : {100ULL, 4096ULL, 3ULL << 16, (3ULL << 16) + 17}) {
+      auto data = pattern(size);
+      TempFile f{data};
+      for (uint64_t start : {0ULL, 1ULL, 4096ULL})
+        for (uint64_t chunk : {0ULL, 1ULL, 1ULL << 16}) {
+          if (start > size) continue;
+          uint8_t expected[64], out[64];
+          Streebog{Streebog::Mode::H512}(data.data() + start, size - start, expected);
+          const int fd = open(f.path.c_str(), O_RDONLY);
+          lseek(fd, start, SEEK_SET);
+          REQUIRE(hash_fd_direct(fd, Streebog::Mode::H512, out, chunk) == 0);
+          REQUIRE(lseek(fd, 0, SEEK_CUR) == (off_t)size);
+          close(fd);
+          REQUIRE(memcmp(expected, out, 64) == 0);
+        }
+    }
+  }
+
+  TEST_CASE("mmap windows with any hints and start offset") {
+    auto data = pattern((2ULL << 20) + 4096 + 123);
+    TempFile f{data};
+
+    const MmapConfig configs[] = {{0, false, false, false, false}, {1, true, true, true, true}, {}};
+    for (uint64_t start : {0ULL, (2ULL << 20) + 5})
+      for (auto& cfg : configs) {
+        uint8_t expected[32], out[32];
+        Streebog{Streebog::Mode::H256}(data.data() + start, data.size() - start, expected);
+        const int fd = open(f.path.c_str(), O_RDONLY);
+        lseek(fd, start, SEEK_SET);
+        REQUIRE(hash_fd_mmap(fd, Streebog::Mode::H256, out, cfg) == 0);
+        REQUIRE(lseek(fd, 0, SEEK_CUR) == (off_t)data.size());
+        close(fd);
+        REQUIRE(memcmp(expected, out, 32) == 0);
+      }
+  }
+
+  TEST_CASE("io_uring reader shares its buffers among files") {
+    std::vector<std::vector<uint8_t>> data;
+    std::vector<TempFile> files;
+    files.reserve(7);
+    for (uint64_t size : {0ULL, 5ULL, 4096ULL, (1ULL << 18) + 3, 1ULL << 19, 3ULL << 18, 100000ULL}) {
+      data.push_back(pattern(size));
+      files.emplace_back(data.back());
+    }
+
+    for (uint32_t depth : {1, 3, 16}) {
+      UringReader reader{{depth, 1ULL << 16}};
+      std::vector<int> fd, err(files.size(), -1);
+      std::vector<std::vector<uint8_t>> out(files.size(), std::vector<uint8_t>(64));
+      std::vector<void*> outs;
+      for (auto& f : files) fd.push_back(open(f.path.c_str(), O_RDONLY));
+      for (auto& o : out) outs.push_back(o.data());
+      reader.hash_fds(fd.size(), fd.data(), Streebog::Mode::H512, outs.data(), err.data());
+
+      for (uint64_t i{}; i < files.size(); i++) {
+        uint8_t expected[64];
+        Streebog{Streebog::Mode::H512}(data[i].data(), data[i].size(), expected);
+        REQUIRE(err[i] == 0);
+        REQUIRE(memcmp(expected, out[i].data(), 64) == 0);
+        REQUIRE(lseek(fd[i], 0, SEEK_CUR) == (off_t)data[i].size());
+        close(fd[i]);
+      }
+    }
+  }
+
+  TEST_CASE("pipes are read to the end") {
+    auto data = pattern(2100000);
+    uint8_t expected[32], out[32];
+    Streebog{Streebog::Mode::H256}(data.data(), data.size(), expected);
+
+    for (auto m : {ReadMethod::Auto, ReadMethod::Read, ReadMethod::Mmap}) {
+      int p[2];
+      REQUIRE(pipe(p) == 0);
+      std::thread writer([&] {
+        for (uint64_t off{}; off < data.size(); off += 1000) REQUIRE(write(p[1], data.data() + off, 1000) == 1000);
+        close(p[1]);
+      });
+
+      REQUIRE(hash_fd(p[0], Streebog::Mode::H256, out, m) == 0);
+      writer.join();
+      close(p[0]);
+      REQUIRE(memcmp(expected, out, 32) == 0);
+    }
+  }
+
+  TEST_CASE("holes of sparse files hash as zeros") {
+    const auto size = 3ULL << 20;
+    std::vector<uint8_t> data(size);
+    TempFile f{{}};
+    const int fd = open(f.path.c_str(), O_RDWR);
+    REQUIRE(ftruncate(fd, size) == 0);
+    for (uint64_t off : {4096ULL, (1ULL << 20) + 100, size - 10}) {  // data at the start, the middle and the end
+      auto p = pattern(10);
+      memcpy(data.data() + off, p.data(), 10);
+      REQUIRE(pwrite(fd, p.data(), 10, off) == 10);
+    }
+
+    uint8_t expected[64], out[64];
+    Streebog{Streebog::Mode::H512}(data.data(), size, expected);
+    for (uint64_t start : {0ULL, 4000ULL}) {
+      if (start) Streebog{Streebog::Mode::H512}(data.data() + start, size - start, expected);
+      lseek(fd, start, SEEK_SET);
+      REQUIRE(hash_fd(fd, Streebog::Mode::H512, out) == 0);
+      REQUIRE(lseek(fd, 0, SEEK_CUR) == (off_t)size);
+      REQUIRE(memcmp(expected, out, 64) == 0);
+    }
+    close(fd);
+  }
+
+  TEST_CASE("copy while hashing") {
+    for (uint64_t size : {0ULL, 100ULL, (1ULL << 18) + 5}) {
+      auto data = pattern(size);
+      TempFile src{data}, dst{{}};
+      uint8_t expected[64], out[64];
+      Streebog{Streebog::Mode::H512}(data.data(), size, expected);
+
+      const int fd = open(src.path.c_str(), O_RDONLY), dest = open(dst.path.c_str(), O_WRONLY | O_TRUNC);
+      REQUIRE(hash_copy(fd, dest, Streebog::Mode::H512, out, PipelineConfig{2, 4096}) == 0);
+      close(fd), close(dest);
+      REQUIRE(memcmp(expected, out, 64) == 0);
+
+      std::vector<uint8_t> copied(size + 1);
+      const int check = open(dst.path.c_str(), O_RDONLY);
+      REQUIRE(read(check, copied.data(), copied.size()) == (ssize_t)size);
+      close(check);
+      REQUIRE(memcmp(copied.data(), data.data(), size) == 0);
+    }
+  }
+
+  TEST_CASE("copy stops at a failed write") {
+    auto data = pattern(1ULL << 16);
+    TempFile src{data};
+    uint8_t out[64];
+    const int fd = open(src.path.c_str(), O_RDONLY), dest = open(src.path.c_str(), O_RDONLY);
+    REQUIRE(hash_copy(fd, dest, Streebog::Mode::H512, out) == EBADF);
+    close(fd), close(dest);
+  }
+
+  TEST_CASE("segment hashes in the same pass") {
+    // chunks that do not divide the segment, a segment that is not a multiple of 64, a short last segment
+    for (uint64_t size : {0ULL, 100ULL, 3 * 10000ULL, 3 * 10000ULL + 7}) {
+      auto data = pattern(size);
+      TempFile f{data};
+      uint8_t expected[32], out[32];
+      Streebog{Streebog::Mode::H256}(data.data(), size, expected);
+
+      std::vector<uint8_t> parts;
+      const int fd = open(f.path.c_str(), O_RDONLY);
+      REQUIRE(hash_fd_segments(fd, Streebog::Mode::H256, out, 10000, parts, PipelineConfig{2, 4096}) == 0);
+      close(fd);
+      REQUIRE(memcmp(expected, out, 32) == 0);
+
+      REQUIRE(parts.size() == (size + 9999) / 10000 * 32);
+      for (uint64_t i{}; i < parts.size() / 32; i++) {
+        Streebog{Streebog::Mode::H256}(data.data() + i * 10000, std::min<uint64_t>(10000, size - i * 10000), out);
+        CHECK(memcmp(parts.data() + i * 32, out, 32) == 0);
+      }
+    }
+
+    std::vector<uint8_t> parts;
+    uint8_t out[64];
+    CHECK(hash_fd_segments(STDIN_FILENO, Streebog::Mode::H512, out, 0, parts) == EINVAL);
+  }
+
+  TEST_CASE("segment hashes from several threads come in data order") {
+    // many segments in flight at once: 8 buffers of 4KB span up to 33 segments of 1000 bytes
+    const uint64_t size = 100 * 1000 + 13;
+    auto data = pattern(size);
+    TempFile f{data};
+    uint8_t expected[64], out[64];
+    Streebog{Streebog::Mode::H512}(data.data(), size, expected);
+
+    for (unsigned threads : {1u, 2u, 4u, 7u}) {
+      CAPTURE(threads);
+      std::vector<uint8_t> parts;
+      const int fd = open(f.path.c_str(), O_RDONLY);
+      REQUIRE(hash_fd_segments(fd, Streebog::Mode::H512, out, 1000, parts, PipelineConfig{8, 4096}, threads) == 0);
+      close(fd);
+      CHECK(memcmp(expected, out, 64) == 0);
+
+      REQUIRE(parts.size() == 101 * 64);
+      for (uint64_t i{}; i < 101; i++) {
+        Streebog{Streebog::Mode::H512}(data.data() + i * 1000, std::min<uint64_t>(1000, size - i * 1000), out);
+        CAPTURE(i);
+        CHECK(memcmp(parts.data() + i * 64, out, 64) == 0);
+      }
+    }
+  }
+
+  TEST_CASE("checkpoints resume a growing file") {
+    auto data = pattern(300000);
+    TempFile f{std::vector<uint8_t>(data.begin(), data.begin() + 100000)};
+    const int fd = open(f.path.c_str(), O_RDWR);
+    const uint64_t interval = 32768;
+    Checkpoint cp[2]{};
+
+    auto check = [&](const uint64_t size) {
+      uint8_t expected[32], out[32];
+      Streebog{Streebog::Mode::H256}(data.data(), size, expected);
+      REQUIRE(hash_fd_checkpointed(fd, Streebog::Mode::H256, out, interval, cp) == 0);
+      REQUIRE(memcmp(expected, out, 32) == 0);
+      REQUIRE(cp[1].offset == size / interval * interval);
+      REQUIRE(cp[1].offset - cp[0].offset == (size < interval ? 0 : interval));
+    };
+
+    check(100000);
+    REQUIRE(pwrite(fd, data.data() + 100000, 150000, 100000) == 150000);  // appended
+    check(250000);
+    data[240000] ^= 1;  // changed in the last region: hashed from the start
+    REQUIRE(pwrite(fd, data.data() + 240000, 1, 240000) == 1);
+    check(250000);
+    REQUIRE(pwrite(fd, data.data() + 250000, 50000, 250000) == 50000);
+    check(300000);
+    REQUIRE(ftruncate(fd, 1000) == 0);  // shrunk below the checkpoints
+    check(1000);
+    close(fd);
+  }
+
+  TEST_CASE("missing file") {
+    uint8_t out[64];
+    REQUIRE(hash_file("/nonexistent/stbg", Streebog::Mode::H512, out) == ENOENT);
+  }
+
+  TEST_CASE("hex round trip") {
+    uint64_t expected[] = {0x890b59d8ef1e159d, 0x27f94ab76cbaa6da, 0xa449b16b0251d05d, 0x00557be5e584fd52}, out[4];
+    char hex[65];
+    digest_to_hex(expected, Streebog::Mode::H256, hex);
+    REQUIRE(std::string(hex) == "00557be5e584fd52a449b16b0251d05d27f94ab76cbaa6da890b59d8ef1e159d");
+    REQUIRE(hex_to_digest("00557BE5E584FD52a449b16b0251d05d27f94ab76cbaa6da890b59d8ef1e159d", Streebog::Mode::H256,
+                          out));
+    REQUIRE(memcmp(expected, out, 32) == 0);
+    REQUIRE(!hex_to_digest("x0557be5e584fd52a449b16b0251d05d27f94ab76cbaa6da890b59d8ef1e159d", Streebog::Mode::H256,
+                           out));
+  }
+}
@@ -0,0 +1,135 @@
+/**
+ * @file    ingest_test.cc
+ * @brief   Tests of the buffered stream and ordered multi-producer ingestion
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#include <string.h>
+
+#include <thread>
+#include <vector>
+
+#include "doctest.h"
+#include "ingest.hh"
+
+static std::vector<uint8_t> pattern(const uint64_t size) {
+  std::vector<uint8_t> v(size);
+  for (uint64_t i{}; i < size; i++) v[i] = (uint8_t)(i * 131 + (i >> 8));
+  return v;
+}
+
+TEST_SUITE("stream") {
+  TEST_CASE("arbitrary chunking gives the one-shot hash") {
+    auto data = pattern(1000);
+    for (auto mode : {Streebog::Mode::H512, Streebog::Mode::H256}) {
+      uint8_t expected[64], out[64];
+      Streebog{mode}(data.data(), data.size(), expected);
+
+      for (uint64_t step : {1, 7, 63, 64, 65, 200}) {
+        StreebogStream s{mode};
+        for (uint64_t off{}; off < data.size(); off += step)
+          s.update(data.data() + off, (data.size() - off < step ? data.size() - off : step));
+
+        s.digest(out);  // must not affect the state
+        REQUIRE(memcmp(expected, out, Streebog::digest_size(mode)) == 0);
+        s.finalize(out);
+        REQUIRE(memcmp(expected, out, Streebog::digest_size(mode)) == 0);
+      }
+    }
+  }
+
+  TEST_CASE("zero runs give the hash of zero bytes") {
+    auto data = pattern(1000);
+    memset(data.data() + 10, 0, 900);
+    for (auto mode : {Streebog::Mode::H512, Streebog::Mode::H256}) {
+      uint8_t expected[64], out[64];
+      Streebog{mode}(data.data(), data.size(), expected);
+
+      for (uint64_t from : {10, 64, 100})
+        for (uint64_t to : {128, 640, 910}) {
+          StreebogStream s{mode};
+          s.update(data.data(), from);
+          s.update_zeros(to - from);
+          s.update(data.data() + to, data.size() - to);
+          s.finalize(out);
+          REQUIRE(memcmp(expected, out, Streebog::digest_size(mode)) == 0);
+        }
+    }
+  }
+
+  TEST_CASE("resumed midstate continues the message") {
+    auto data = pattern(1000);
+    for (auto mode : {Streebog::Mode::H512, Streebog::Mode::H256}) {
+      uint8_t expected[64], out[64];
+      Streebog{mode}(data.data(), data.size(), expected);
+
+      for (uint64_t at : {0, 64, 512, 960}) {
+        StreebogStream first{mode}, second{mode};
+        first.update(data.data(), at);
+        second.update(data.data(), 100);  // whatever was there is replaced
+        second.resume(first.midstate());
+        second.update(data.data() + at, data.size() - at);
+        second.finalize(out);
+        REQUIRE(memcmp(expected, out, Streebog::digest_size(mode)) == 0);
+      }
+    }
+  }
+}
+
+TEST_SUITE("ordered ingest") {
+  TEST_CASE("records from many producers are hashed in sequence order") {
+    constexpr uint64_t records = 2000, producers = 4;
+    std::vector<std::vector<uint8_t>> recs;
+    std::vector<uint8_t> whole;
+    for (uint64_t i{}; i < records; i++) {
+      recs.push_back(pattern(i % 97 + 1));
+      recs.back()[0] = (uint8_t)i;
+      whole.insert(whole.end(), recs.back().begin(), recs.back().end());
+    }
+
+    uint8_t expected[64], out[64];
+    Streebog{Streebog::Mode::H512}(whole.data(), whole.size(), expected);
+
+    uint64_t seals{}, released{};
+    OrderedIngest::Config cfg;
+    cfg.capacity = 64, cfg.batch = 8, cfg.seal_every = 500;
+    cfg.on_seal = [&](uint64_t, void const*) { seals++; };
+    cfg.on_release = [&](uint64_t, void const*) { released++; };
+    OrderedIngest ingest{Streebog::Mode::H512, cfg};
+
+    std::vector<std::thread> threads;
+    for (uint64_t p{}; p < producers; p++)
+      threads.emplace_back([&, p] {
+        for (uint64_t i = p; i < records; i += producers) ingest.publish(i, recs[i].data(), recs[i].size());
+      });
+    for (auto& t : threads) t.join();
+
+    ingest.finish(records, out);
+    REQUIRE(memcmp(expected, out, 64) == 0);
+    REQUIRE(seals == records / 500);
+    REQUIRE(released == records);
+  }
+
+  TEST_CASE("seal digest equals the digest of the prefix") {
+    auto a = pattern(100), b = pattern(30);
+    std::vector<uint8_t> ab(a);
+    ab.insert(ab.end(), b.begin(), b.end());
+
+    uint8_t expected[32], sealed[32]{}, out[32];
+    Streebog{Streebog::Mode::H256}(ab.data(), ab.size(), expected);
+
+    OrderedIngest::Config cfg;
+    cfg.seal_every = 2;
+    cfg.on_seal = [&](uint64_t, void const* d) { memcpy(sealed, d, 32); };
+    OrderedIngest ingest{Streebog::Mode::H256, cfg};
+    ingest.publish(1, b.data(), b.size());
+    ingest.publish(0, a.data(), a.size());
+    ingest.finish(2, out);
+
+    REQUIRE(memcmp(expected, sealed, 32) == 0);
+    REQUIRE(memcmp(expected, out, 32) == 0);
+  }
+}
@@ -0,0 +1,201 @@
+/**
+ * @file    merkle_test.cc
+ * @brief   Tests of the incremental Merkle tree
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "doctest.h"
+#include "merkle.hh"
+#include "test_util.hh"
+
+namespace {
+  constexpr uint64_t LEAF = 4096;
+
+  std::vector<uint8_t> root_of(MerkleTree const& t) {
+    std::vector<uint8_t> r(32);
+    t.root(r.data());
+    return r;
+  }
+
+  /**
+   * @brief root of a tree built from scratch, for comparison with an updated one
+   */
+  std::vector<uint8_t> fresh_root(const int fd) {
+    MerkleTree t{{LEAF, 2}};
+    REQUIRE(t.build(fd) == 0);
+    return root_of(t);
+  }
+
+  std::vector<uint8_t> leaf_digests(const int fd, const uint64_t first, const uint64_t last) {
+    std::vector<uint8_t> out, buf(LEAF);
+    for (uint64_t i = first; i <= last; i++) {
+      auto n = pread(fd, buf.data(), LEAF, i * LEAF);
+      REQUIRE(n >= 0);
+      uint8_t d[32];
+      MerkleTree::hash_leaf(buf.data(), n, d);
+      out.insert(out.end(), d, d + 32);
+    }
+    return out;
+  }
+}  // namespace
+
+TEST_SUITE("merkle") {
+  TEST_CASE("updates give the root of a full rebuild") {
+    Temp f;
+    f.write_at(0, noise(10 * LEAF + 100, 1));  // 11 leaves, the last one short
+    MerkleTree t{{LEAF, 3}};
+    REQUIRE(t.build(f.fd) == 0);
+    CHECK(t.leaves() == 11);
+    CHECK(root_of(t) == fresh_root(f.fd));
+
+    // two tagged leaves with one tagged node above them
+    uint8_t leaf[1 + LEAF], ab[65], top[32];
+    {
+      Temp g;
+      auto data = noise(LEAF + 1, 2);
+      g.write_at(0, data);
+      MerkleTree two{{LEAF, 1}};
+      REQUIRE(two.build(g.fd) == 0);
+      leaf[0] = 0x00, memcpy(leaf + 1, data.data(), LEAF);
+      Streebog{Streebog::Mode::H256}(leaf, 1 + LEAF, ab + 1);
+      memcpy(leaf + 1, data.data() + LEAF, 1);
+      Streebog{Streebog::Mode::H256}(leaf, 2, ab + 33);
+      CHECK(leaf_digests(g.fd, 0, 1) == std::vector<uint8_t>(ab + 1, ab + 65));
+      ab[0] = 0x01;
+      Streebog{Streebog::Mode::H256}(ab, 65, top);
+      uint8_t r[1 + 8 + 32] = {0x02, 2}, root[32];  // the tag, two leaves, the top node
+      memcpy(r + 9, top, 32);
+      Streebog{Streebog::Mode::H256}(r, sizeof(r), root);
+      CHECK(root_of(two) == std::vector<uint8_t>(root, root + 32));
+    }
+
+    f.write_at(5 * LEAF + 10, noise(20, 3));
+    REQUIRE(t.update(f.fd, 5 * LEAF + 10, 20) == 0);
+    CHECK(root_of(t) == fresh_root(f.fd));
+
+    f.write_at(0, noise(10, 4)), f.write_at(9 * LEAF, noise(10, 5));
+    REQUIRE(t.update(f.fd, {{0, 10}, {9 * LEAF, 10}}) == 0);
+    CHECK(root_of(t) == fresh_root(f.fd));
+
+    f.write_at(10 * LEAF + 100, noise(7 * LEAF, 6));  // grown to 18 leaves
+    REQUIRE(t.update(f.fd, 10 * LEAF + 100, 7 * LEAF) == 0);
+    CHECK(t.leaves() == 18);
+    CHECK(root_of(t) == fresh_root(f.fd));
+
+    REQUIRE(ftruncate(f.fd, 3 * LEAF) == 0);  // shrunk to 3
+    REQUIRE(t.update(f.fd, 0, 0) == 0);
+    CHECK(t.leaves() == 3);
+    CHECK(root_of(t) == fresh_root(f.fd));
+
+    REQUIRE(ftruncate(f.fd, 0) == 0);
+    REQUIRE(t.update(f.fd, 0, 0) == 0);
+    CHECK(t.leaves() == 1);
+    CHECK(root_of(t) == fresh_root(f.fd));
+  }
+
+  TEST_CASE("range proofs") {
+    Temp f;
+    f.write_at(0, noise(12 * LEAF + 1, 7));  // 13 leaves: the carried-up nodes are on the right edge
+    MerkleTree t{{LEAF, 2}};
+    REQUIRE(t.build(f.fd) == 0);
+    auto root = root_of(t);
+
+    for (uint64_t first{}; first < 13; first++)
+      for (uint64_t last = first; last < 13; last++) {
+        MerkleProof p;
+        REQUIRE(t.prove(first, last, p) == 0);
+        CHECK(p.nodes.size() <= 2 * 32 * 4);
+        auto leaves = leaf_digests(f.fd, first, last);
+        CHECK(MerkleTree::verify(root.data(), p, leaves.data()));
+
+        leaves[0] ^= 1;
+        CHECK(!MerkleTree::verify(root.data(), p, leaves.data()));
+        leaves[0] ^= 1;
+        if (!p.nodes.empty()) {
+          p.nodes.pop_back();
+          CHECK(!MerkleTree::verify(root.data(), p, leaves.data()));
+        }
+      }
+
+    MerkleProof p;
+    CHECK(t.prove(3, 13, p) == EINVAL);
+    CHECK(t.prove(4, 3, p) == EINVAL);
+  }
+
+  TEST_CASE("inner nodes do not pass for leaves") {
+    Temp f;
+    f.write_at(0, noise(4 * LEAF, 10));
+    MerkleTree t{{LEAF, 1}};
+    REQUIRE(t.build(f.fd) == 0);
+    auto root = root_of(t);
+
+    // a "file" of two 64-byte blocks holding the children of the two nodes below the root: without the tags its
+    // leaves would be those nodes and a two-leaf proof would hash up to the root
+    auto l = leaf_digests(f.fd, 0, 3);
+    std::vector<uint8_t> forged(64);
+    MerkleTree::hash_leaf(l.data(), 64, forged.data());
+    MerkleTree::hash_leaf(l.data() + 64, 64, forged.data() + 32);
+    CHECK(!MerkleTree::verify(root.data(), MerkleProof{2, 0, 1, {}}, forged.data()));
+
+    MerkleProof p;
+    REQUIRE(t.prove(0, 3, p) == 0);
+    CHECK(MerkleTree::verify(root.data(), p, l.data()));
+  }
+
+  TEST_CASE("a proof for another number of leaves does not pass") {
+    Temp f;
+    f.write_at(0, noise(2 * LEAF + 1, 11));  // leaves a, b, c; the top node is H(0x01 || H(0x01 || a || b) || c)
+    MerkleTree t{{LEAF, 1}};
+    REQUIRE(t.build(f.fd) == 0);
+    auto root = root_of(t);
+    auto l = leaf_digests(f.fd, 0, 2);
+
+    // as the second leaf of a two-leaf tree whose first leaf is the node above a and b, c hashes to the same top node
+    uint8_t ab[65];
+    ab[0] = 0x01, memcpy(ab + 1, l.data(), 64);
+    MerkleProof forged{2, 1, 1, std::vector<uint8_t>(32)};
+    Streebog{Streebog::Mode::H256}(ab, 65, forged.nodes.data());
+    CHECK(!MerkleTree::verify(root.data(), forged, l.data() + 64));
+
+    MerkleProof p;
+    REQUIRE(t.prove(2, 2, p) == 0);
+    CHECK(p.leaves == 3);
+    CHECK(MerkleTree::verify(root.data(), p, l.data() + 64));
+  }
+
+  TEST_CASE("save and load") {
+    Temp f, saved;
+    f.write_at(0, noise(5 * LEAF, 8));
+    MerkleTree t{{LEAF, 1}};
+    REQUIRE(t.build(f.fd) == 0);
+    REQUIRE(t.save(saved.fd) == 0);
+
+    MerkleTree u;
+    lseek(saved.fd, 0, SEEK_SET);
+    REQUIRE(u.load(saved.fd) == 0);
+    CHECK(u.leaf_size() == LEAF);
+    CHECK(u.file_size() == 5 * LEAF);
+    CHECK(root_of(u) == root_of(t));
+
+    // a loaded tree is updated like the one it was saved from
+    f.write_at(LEAF, noise(1, 9));
+    REQUIRE(u.update(f.fd, LEAF, 1) == 0);
+    CHECK(root_of(u) == fresh_root(f.fd));
+
+    REQUIRE(ftruncate(saved.fd, 100) == 0);
+    lseek(saved.fd, 0, SEEK_SET);
+    CHECK(u.load(saved.fd) == EBADMSG);
+  }
+}
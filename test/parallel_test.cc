@@ -0,0 +1,145 @@
+/**
+ * @file    parallel_test.cc
+ * @brief   Tests of the multi-file scheduler of the stbg utility
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "../tool/stbg.hh"
+#include "doctest.h"
+#include "test_util.hh"
+
+namespace {
+  /**
+   * @brief files of the given sizes named by their number, with jobs for them in alternating modes
+   */
+  struct Files {
+    TempDir dir;
+    std::vector<uint64_t> sizes;
+    std::vector<FileJob> jobs;
+
+    explicit Files(std::vector<uint64_t> const& _sizes) : sizes{_sizes} {
+      for (uint64_t i{}; i < sizes.size(); i++) {
+        dir.add(std::to_string(i), noise(sizes[i], i + 1));
+        const auto mode = (i & 1 ? Streebog::Mode::H512 : Streebog::Mode::H256);
+        jobs.push_back({dir.path + '/' + std::to_string(i), mode, 0, {}});
+      }
+    }
+
+    /**
+     * @brief hash_parallel() of every job; returns the reported indices
+     */
+    std::vector<uint64_t> run(Options const& opt, const uint64_t stop_after = ~0ULL) {
+      std::vector<uint64_t> reported;
+      hash_parallel(jobs, opt, [&](const uint64_t i) {
+        reported.push_back(i);
+        return reported.size() < stop_after;
+      });
+      return reported;
+    }
+  };
+
+  Options options(const unsigned threads, const bool keep_order) {
+    Options opt{.mode = Streebog::Mode::H512, .prog = "stbg"};
+    opt.threads = threads, opt.keep_order = keep_order;
+    return opt;
+  }
+
+  /**
+   * @brief a mix of large files and more small (< 64KB) ones than fit in one batch
+   */
+  std::vector<uint64_t> mixed_sizes() {
+    std::vector<uint64_t> sizes{300000, 0, 65535, 65536, 1 << 20, 100, 70000};
+    for (uint64_t i{}; i < 40; i++) sizes.push_back(1000 + i * 37 % 500);
+    return sizes;
+  }
+}  // namespace
+
+TEST_SUITE("parallel") {
+  TEST_CASE("digests of small and large files are the ones of hash_file()") {
+    Files f{mixed_sizes()};
+    f.jobs.push_back({f.dir.path + "/missing", Streebog::Mode::H256, 0, {}});
+
+    for (unsigned threads : {1u, 3u}) {
+      auto reported = f.run(options(threads, false));
+      std::sort(reported.begin(), reported.end());
+      REQUIRE(reported.size() == f.jobs.size());
+      for (uint64_t i{}; i < reported.size(); i++) CHECK(reported[i] == i);
+
+      for (uint64_t i{}; i < f.sizes.size(); i++) {
+        uint8_t expected[64];
+        REQUIRE(hash_file(f.jobs[i].path.c_str(), f.jobs[i].mode, expected) == 0);
+        CAPTURE(i);
+        CHECK(f.jobs[i].err == 0);
+        CHECK(memcmp(expected, f.jobs[i].digest, Streebog::digest_size(f.jobs[i].mode)) == 0);
+      }
+      CHECK(f.jobs.back().err == ENOENT);
+    }
+  }
+
+  TEST_CASE("files grouped through io_uring get the digests of hash_file()") {
+    std::vector<uint64_t> sizes{5 << 20, 100};
+    for (uint64_t i{}; i < 40; i++) sizes.push_back(70000 + i * 40009);  // more medium files than fit in one group
+    Files f{sizes};
+    f.jobs.push_back({f.dir.path + "/missing", Streebog::Mode::H512, 0, {}});
+
+    auto opt = options(2, true);
+    opt.method = ReadMethod::Uring;
+    CHECK(f.run(opt).size() == f.jobs.size());
+    for (uint64_t i{}; i < f.sizes.size(); i++) {
+      uint8_t expected[64];
+      REQUIRE(hash_file(f.jobs[i].path.c_str(), f.jobs[i].mode, expected) == 0);
+      CAPTURE(i);
+      CHECK(f.jobs[i].err == 0);
+      CHECK(memcmp(expected, f.jobs[i].digest, Streebog::digest_size(f.jobs[i].mode)) == 0);
+    }
+    CHECK(f.jobs.back().err == ENOENT);
+  }
+
+  TEST_CASE("one worker takes the largest files first") {
+    Files f{mixed_sizes()};
+    auto reported = f.run(options(1, false));
+
+    // with a single worker the completion order is the dispatch order: by size, ties in the order of the jobs
+    std::vector<uint64_t> expected(f.sizes.size());
+    for (uint64_t i{}; i < expected.size(); i++) expected[i] = i;
+    std::stable_sort(expected.begin(), expected.end(),
+                     [&](const uint64_t a, const uint64_t b) { return f.sizes[a] > f.sizes[b]; });
+    CHECK(reported == expected);
+  }
+
+  TEST_CASE("keep_order reports in the order of the jobs") {
+    Files f{mixed_sizes()};
+    for (unsigned threads : {1u, 4u}) {
+      auto reported = f.run(options(threads, true));
+      REQUIRE(reported.size() == f.sizes.size());
+      for (uint64_t i{}; i < reported.size(); i++) CHECK(reported[i] == i);
+    }
+  }
+
+  TEST_CASE("returning false from on_done stops the reports") {
+    Files f{mixed_sizes()};
+    for (bool keep_order : {false, true}) {
+      auto reported = f.run(options(2, keep_order), 3);
+      CHECK(reported.size() == 3);
+      if (keep_order) CHECK(reported == std::vector<uint64_t>{0, 1, 2});
+    }
+
+    // the files not reported are not started, or at most the ones already taken by the worker
+    Files g{{4 << 20, 4 << 20, 4 << 20, 4 << 20, 4 << 20, 4 << 20}};
+    for (auto& j : g.jobs) memset(j.digest, 0, sizeof(j.digest));
+    CHECK(g.run(options(1, false), 1).size() == 1);
+    uint64_t untouched{};
+    for (auto& j : g.jobs) untouched += std::all_of(j.digest, j.digest + 64, [](uint8_t b) { return !b; });
+    CHECK(untouched >= 4);
+  }
+}
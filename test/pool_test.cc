@@ -0,0 +1,69 @@
+/**
+ * @file    pool_test.cc
+ * @brief   Tests of the context arena
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#include <string.h>
+
+#include <thread>
+#include <vector>
+
+#include "doctest.h"
+#include "pool.hh"
+
+TEST_SUITE("context pool") {
+  TEST_CASE("slots are aligned, reused and reset") {
+    StreebogPool pool{2};
+    REQUIRE(pool.capacity() == 2);
+    auto a = pool.acquire(Streebog::Mode::H512);
+    auto b = pool.acquire(Streebog::Mode::H256);
+    REQUIRE(a);
+    REQUIRE(b);
+    REQUIRE(!pool.acquire(Streebog::Mode::H512));
+    REQUIRE((uintptr_t)a.get() % 64 == 0);
+    REQUIRE((uintptr_t)b.get() % 64 == 0);
+    REQUIRE(((uintptr_t)b.get() > (uintptr_t)a.get() ? (uintptr_t)b.get() - (uintptr_t)a.get()
+                                                      : (uintptr_t)a.get() - (uintptr_t)b.get()) >= sizeof(Streebog));
+
+    alignas(32) uint8_t block[64]{1, 2, 3};
+    b->update(block, 64);
+    auto used = b.get();
+    b.reset();
+
+    b = pool.acquire(Streebog::Mode::H256);
+    REQUIRE(b.get() == used);
+
+    uint8_t expected[32], out[32];
+    Streebog{Streebog::Mode::H256}(block, 10, expected);
+    (*b)(block, 10, out);
+    REQUIRE(memcmp(expected, out, 32) == 0);
+  }
+
+  TEST_CASE("concurrent acquire and release") {
+    StreebogStreamPool pool{8};
+    std::vector<std::thread> th;
+    std::atomic<int> bad{};
+    for (int t{}; t < 4; t++)
+      th.emplace_back([&] {
+        for (int i{}; i < 2000; i++) {
+          auto c = pool.acquire(Streebog::Mode::H512);
+          if (!c) continue;
+          uint8_t d[64] = {(uint8_t)i}, out[64], expected[64];
+          c->update(d, 5);
+          c->finalize(out);
+          Streebog{Streebog::Mode::H512}(d, 5, expected);
+          bad += memcmp(expected, out, 64) != 0;
+        }
+      });
+    for (auto& t : th) t.join();
+    REQUIRE(bad == 0);
+
+    std::vector<StreebogStreamPool::Ptr> all;
+    for (int i{}; i < 8; i++) all.push_back(pool.acquire(Streebog::Mode::H256));
+    for (auto& c : all) REQUIRE(c);
+  }
+}
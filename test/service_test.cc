@@ -0,0 +1,137 @@
+/**
+ * @file    service_test.cc
+ * @brief   Tests of the thread pool hashing service
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "doctest.h"
+#include "service.hh"
+
+TEST_SUITE("hash service") {
+  TEST_CASE("buffers and files give the one-shot hashes") {
+    std::vector<uint8_t> data(300000);
+    for (uint64_t i{}; i < data.size(); i++) data[i] = (uint8_t)(i ^ (i >> 9));
+
+    const uint64_t sizes[] = {0, 10, 64, 1000, 5000, 70000, 300000};
+    constexpr uint64_t count = sizeof(sizes) / sizeof(sizes[0]);
+    uint8_t expected[count][64], got[count][64]{}, got_fd[64]{};
+    for (uint64_t i{}; i < count; i++) Streebog{Streebog::Mode::H256}(data.data(), sizes[i], expected[i]);
+
+    auto f = tmpfile();
+    REQUIRE(fwrite(data.data(), 1, data.size(), f) == data.size());
+    fflush(f);
+    lseek(fileno(f), 0, SEEK_SET);
+
+    HashService::Config cfg;
+    cfg.threads = 3, cfg.small_job = 8192, cfg.read_size = 4096;
+    {
+      HashService svc{cfg};
+      std::atomic<int> errs{};
+      for (uint64_t i{}; i < count; i++)
+        svc.submit(data.data(), sizes[i], Streebog::Mode::H256, [&, i](int err, void const* d) {
+          errs += err;
+          memcpy(got[i], d, 32);
+        });
+      svc.submit(fileno(f), Streebog::Mode::H256, [&](int err, void const* d) {
+        errs += err;
+        memcpy(got_fd, d, 32);
+      });
+      svc.wait();
+
+      REQUIRE(errs == 0);
+      REQUIRE(svc.queue_depth() == 0);
+      uint64_t jobs{}, bytes{};
+      for (auto& s : svc.stats()) jobs += s.jobs, bytes += s.bytes;
+      REQUIRE(jobs == count + 1);
+      REQUIRE(bytes == 376074 + data.size());
+    }
+    fclose(f);
+
+    for (uint64_t i{}; i < count; i++) REQUIRE(memcmp(expected[i], got[i], 32) == 0);
+    REQUIRE(memcmp(expected[count - 1], got_fd, 32) == 0);
+  }
+
+  TEST_CASE("a worker reuses its contexts across files and modes") {
+    std::vector<uint8_t> data(10000, 0x42);
+    uint8_t expected512[64], expected256[32], got[4][64]{};
+    Streebog{Streebog::Mode::H512}(data.data(), data.size(), expected512);
+    Streebog{Streebog::Mode::H256}(data.data(), data.size(), expected256);
+
+    auto f = tmpfile();
+    REQUIRE(fwrite(data.data(), 1, data.size(), f) == data.size());
+    fflush(f);
+
+    HashService svc{HashService::Config{1}};
+    for (uint64_t i{}; i < 4; i++) {
+      lseek(fileno(f), 0, SEEK_SET);
+      const auto mode = (i & 1 ? Streebog::Mode::H256 : Streebog::Mode::H512);
+      svc.submit(fileno(f), mode, [&, i](int, void const* d) { memcpy(got[i], d, Streebog::digest_size(mode)); });
+      svc.wait();
+    }
+    fclose(f);
+
+    for (uint64_t i{}; i < 4; i++)
+      REQUIRE(memcmp(got[i], (i & 1 ? expected256 : expected512), (i & 1 ? 32 : 64)) == 0);
+  }
+
+  TEST_CASE("large buffers go to their own worker") {
+    std::vector<uint8_t> data(3 << 20);
+    for (uint64_t i{}; i < data.size(); i++) data[i] = (uint8_t)(i * 7 + (i >> 12));
+    uint8_t expected_large[32], expected_mid[32], expected_small[32], got_large[32]{}, got_mid[32]{}, got_small[32]{};
+    Streebog{Streebog::Mode::H256}(data.data(), data.size(), expected_large);
+    Streebog{Streebog::Mode::H256}(data.data(), 100000, expected_mid);
+    Streebog{Streebog::Mode::H256}(data.data(), 1000, expected_small);
+
+    HashService::Config cfg;
+    cfg.threads = 1, cfg.small_job = 4096, cfg.large_job = 1 << 20, cfg.large_threads = 1;
+    HashService svc{cfg};
+    REQUIRE(svc.stats().size() == 2);
+
+    // the large job only completes once the jobs queued after it are done, which needs a second worker
+    std::atomic<int> small_done{};
+    bool waited{};
+    svc.submit(data.data(), data.size(), Streebog::Mode::H256, [&](int, void const* d) {
+      for (int i{}; i < 5000 && small_done.load() < 2; i++) usleep(1000);
+      waited = (small_done.load() == 2);
+      memcpy(got_large, d, 32);
+    });
+    svc.submit(data.data(), 100000, Streebog::Mode::H256, [&](int, void const* d) {
+      memcpy(got_mid, d, 32);
+      small_done++;
+    });
+    svc.submit(data.data(), 1000, Streebog::Mode::H256, [&](int, void const* d) {
+      memcpy(got_small, d, 32);
+      small_done++;
+    });
+    svc.wait();
+
+    CHECK(waited);
+    CHECK(memcmp(expected_large, got_large, 32) == 0);
+    CHECK(memcmp(expected_mid, got_mid, 32) == 0);
+    CHECK(memcmp(expected_small, got_small, 32) == 0);
+    const auto stats = svc.stats();
+    CHECK(stats[0].jobs == 2);
+    CHECK(stats[1].jobs == 1);
+    CHECK(stats[1].bytes == data.size());
+  }
+
+  TEST_CASE("read errors are reported") {
+    int fd = dup(STDIN_FILENO);
+    close(fd);
+
+    HashService svc{HashService::Config{1}};
+    int err{};
+    svc.submit(fd, Streebog::Mode::H512, [&](int e, void const* d) { err = e + (d != nullptr); });
+    svc.wait();
+    REQUIRE(err == EBADF);
+  }
+}
@@ -0,0 +1,140 @@
+/**
+ * @file    stbg_test.cc
+ * @brief   Tests of the stbg utility internals, built with the flags of the library
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <string.h>
+
+#include <string>
+
+#include "../tool/stbg.hh"
+#include "doctest.h"
+#include "test_util.hh"
+
+namespace {
+  const std::string HEX256 = "00557be5e584fd52a449b16b0251d05d27f94ab76cbaa6da890b59d8ef1e159d";
+  const std::string HEX512 = "1b54d01a4af5b9d5cc3d86d68d285462b19abc2475222f35c085122be4ba1ffa"
+                             "00ad30f8767b3a82384c6574f024c311e2a481332b08ef7f41797891c1646f48";
+
+  Options options(const Streebog::Mode mode, const bool mode_set = false) {
+    Options opt{.mode = mode, .prog = "stbg"};
+    opt.mode_set = mode_set;
+    return opt;
+  }
+
+  bool parse(std::string const& line, Options const& opt, FileJob& job, uint8_t* expected) {
+    return parse_check_line(line.data(), line.size(), opt, job, expected);
+  }
+}  // namespace
+
+TEST_SUITE("check") {
+  TEST_CASE("hex parsing of both cases in every position") {
+    uint8_t ref[64], out[64];
+    REQUIRE(hex_to_digest(HEX512.c_str(), Streebog::Mode::H512, ref));
+
+    char hex[129];
+    digest_to_hex(ref, Streebog::Mode::H512, hex);
+    REQUIRE(HEX512 == hex);
+
+    auto upper = HEX512;
+    for (auto& c : upper) c = toupper(c);
+    REQUIRE(hex_to_digest(upper.c_str(), Streebog::Mode::H512, out));
+    REQUIRE(memcmp(ref, out, 64) == 0);
+
+    // chars next to the digit and letter ranges, and ones which pass the ranges after case folding or wrapping
+    for (char bad : {'/', ':', '@', 'G', '`', 'g', ' ', '\0', (char)0x80, (char)0xC1, (char)0xFF})
+      for (uint64_t i{}; i < 128; i++) {
+        auto s = HEX512;
+        s[i] = bad;
+        CHECK_MESSAGE(!hex_to_digest(s.data(), Streebog::Mode::H512, out), "position ", i, " char ", (int)bad);
+      }
+  }
+
+  TEST_CASE("well-formed lines") {
+    uint8_t ref[32], expected[64];
+    REQUIRE(hex_to_digest(HEX256.c_str(), Streebog::Mode::H256, ref));
+    FileJob job;
+    const auto opt = options(Streebog::Mode::H512);
+
+    REQUIRE(parse(HEX256 + "  a b.txt", opt, job, expected));
+    CHECK(job.mode == Streebog::Mode::H256);
+    CHECK(job.path == "a b.txt");
+    CHECK(memcmp(ref, expected, 32) == 0);
+
+    auto upper = HEX256;
+    for (auto& c : upper) c = toupper(c);
+    REQUIRE(parse(upper + " *bin\r", opt, job, expected));
+    CHECK(job.path == "bin");
+    CHECK(memcmp(ref, expected, 32) == 0);
+
+    REQUIRE(parse(HEX512 + "  x", opt, job, expected));
+    CHECK(job.mode == Streebog::Mode::H512);
+
+    REQUIRE(parse("\\" + HEX256 + "  a\\\\b\\nc\\rd", opt, job, expected));
+    CHECK(job.path == "a\\b\nc\rd");
+
+    REQUIRE(parse(HEX256 + "  a\\nb", opt, job, expected));  // not escaped: taken as is
+    CHECK(job.path == "a\\nb");
+  }
+
+  TEST_CASE("malformed lines") {
+    uint8_t expected[64];
+    FileJob job;
+    const auto opt = options(Streebog::Mode::H512);
+    auto with = [](const uint64_t i, const char c) {
+      auto s = HEX256;
+      s[i] = c;
+      return s;
+    };
+
+    for (std::string line : {std::string{}, std::string{"\r"}, std::string{"\\"}, HEX256, HEX256 + " ",
+                             HEX256 + "  ", HEX256 + " x", HEX256 + "\tx", HEX256 + "-  x", HEX256.substr(1) + "  x",
+                             HEX256 + "0  x", HEX512 + "0  x", with(0, 'g') + "  x", with(10, 'z') + "  x",
+                             " " + HEX256 + "  x",
+                             "\\" + HEX256 + "  a\\tb", "\\" + HEX256 + "  a\\"})
+      CHECK_MESSAGE(!parse(line, opt, job, expected), line);
+
+    CHECK(!parse(HEX256 + "  x", options(Streebog::Mode::H512, true), job, expected));
+    CHECK(parse(HEX256 + "  x", options(Streebog::Mode::H256, true), job, expected));
+  }
+
+  TEST_CASE("manifests longer than a window keep their order") {
+    TempDir d;
+    const auto data = noise(1000, 1);
+    d.add("f", data);
+    uint8_t digest[32];
+    char hex[65];
+    Streebog{Streebog::Mode::H256}((void*)data.data(), data.size(), digest);
+    digest_to_hex(digest, Streebog::Mode::H256, hex);
+
+    // one line of a wrong hash after the first window, the rest name the same file
+    const std::string path = d.path + "/f";
+    std::string manifest, good = hex, bad = good;
+    bad[0] = (bad[0] == '0' ? '1' : '0');
+    for (uint64_t i{}; i < 20000; i++) manifest += (i == 17000 ? bad : good) + "  " + path + '\n';
+    d.add("SUMS", std::vector<uint8_t>(manifest.begin(), manifest.end()));
+
+    auto opt = options(Streebog::Mode::H512);
+    opt.keep_order = true, opt.threads = 4;
+    const auto sums = d.path + "/SUMS";
+    int status = -1;
+    auto out = capture_stdout([&] { status = check(sums.c_str(), opt); });
+    CHECK(status == EXIT_FAILURE);
+
+    const std::string ok = path + ": OK\n", failed = path + ": FAILED\n";
+    std::string expected_out;
+    for (uint64_t i{}; i < 20000; i++) expected_out += (i == 17000 ? failed : ok);
+    CHECK(out == expected_out);
+
+    // --fail-fast stops at the failure, the lines after it are never read
+    opt.fail_fast = true;
+    out = capture_stdout([&] { status = check(sums.c_str(), opt); });
+    CHECK(status == EXIT_FAILURE);
+    CHECK(out == expected_out.substr(0, 17000 * ok.size() + failed.size()));
+  }
+}
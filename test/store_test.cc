@@ -0,0 +1,169 @@
+/**
+ * @file    store_test.cc
+ * @brief   Tests of content-defined chunking and of the chunk store
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "doctest.h"
+#include "store.hh"
+#include "test_util.hh"
+
+namespace {
+  const ChunkerConfig SMALL{1024, 4096, 16384};
+
+  std::vector<uint64_t> cuts(std::vector<uint8_t> const& data) {
+    std::vector<uint64_t> v;
+    for (uint64_t pos{}; pos < data.size();) v.push_back(pos += cdc_cut(data.data() + pos, data.size() - pos, SMALL));
+    return v;
+  }
+
+  std::vector<uint8_t> restored(ChunkStore& store, std::vector<ChunkRef> const& recipe) {
+    char tmpl[] = "/tmp/stbg_store_XXXXXX";
+    const int fd = mkstemp(tmpl);
+    unlink(tmpl);
+    REQUIRE(store.restore(recipe, fd) == 0);
+    std::vector<uint8_t> v(lseek(fd, 0, SEEK_END));
+    REQUIRE(pread(fd, v.data(), v.size(), 0) == (ssize_t)v.size());
+    close(fd);
+    return v;
+  }
+}  // namespace
+
+TEST_SUITE("store") {
+  TEST_CASE("chunk boundaries follow the content") {
+    auto data = noise(1 << 19, 1);
+    auto a = cuts(data);
+    for (uint64_t i{}; i < a.size(); i++) {
+      const uint64_t len = a[i] - (i ? a[i - 1] : 0);
+      CHECK(len <= SMALL.max);
+      if (i + 1 < a.size()) CHECK(len >= SMALL.min);
+    }
+    CHECK(a.size() > (1 << 19) / SMALL.max);
+
+    // an insertion moves the cuts after it by its length, apart from the one or two chunks around it
+    auto edited = data;
+    edited.insert(edited.begin() + 200000, 100, 0xAB);
+    auto b = cuts(edited);
+    std::set<uint64_t> before(a.begin(), a.end()), shifted;
+    for (auto c : b) shifted.insert(c > 200000 ? c - 100 : c);
+    uint64_t common{};
+    for (auto c : shifted) common += before.count(c);
+    CHECK(common + 3 >= a.size());
+  }
+
+  TEST_CASE("files are stored once and restored") {
+    TempDir dir;
+    auto data = noise(300000, 2), edited = data;
+    edited.insert(edited.begin() + 150000, 10, 0);
+    data.insert(data.end(), data.begin(), data.begin() + 40000);  // repeated within the file
+
+    ChunkStore::Config cfg;
+    cfg.chunker = SMALL, cfg.index_capacity = 16, cfg.pack_size = 100000, cfg.threads = 3;
+    std::vector<ChunkRef> r1, r2, r3;
+    StoreStats st;
+    {
+      ChunkStore store{dir.path.c_str(), cfg};
+      REQUIRE(store.status() == 0);
+      Temp f{data};
+      REQUIRE(store.put(f.fd, r1, &st) == 0);
+      CHECK(st.bytes == data.size());
+      CHECK(st.new_bytes < data.size() - 20000);
+      CHECK(store.size() == st.new_chunks);
+      CHECK(restored(store, r1) == data);
+
+      Temp g{edited};
+      REQUIRE(store.put(g.fd, r2, &st) == 0);
+      CHECK(st.new_bytes < 3 * SMALL.max);
+      CHECK(restored(store, r2) == edited);
+    }
+
+    // reopened: chunk sizes come from the index, everything is still there
+    cfg.chunker = {};
+    ChunkStore store{dir.path.c_str(), cfg};
+    REQUIRE(store.status() == 0);
+    CHECK(restored(store, r1) == data);
+    Temp f{data};
+    REQUIRE(store.put(f.fd, r3, &st) == 0);
+    CHECK(st.new_bytes == 0);
+
+    Temp empty{{}};
+    REQUIRE(store.put(empty.fd, r3, &st) == 0);
+    CHECK(r3.empty());
+
+    std::vector<uint8_t> out;
+    ChunkRef missing{};
+    CHECK(store.get(missing.digest, out) == ENOENT);
+  }
+
+  TEST_CASE("a crash without flush() loses no chunk the index points to") {
+    TempDir dir;
+    auto a = noise(200000, 5), b = noise(6 << 20, 6);  // b is longer than the pack buffer: partly written
+    ChunkStore::Config cfg;
+    cfg.chunker = SMALL, cfg.threads = 2;
+
+    const pid_t pid = fork();
+    if (!pid) {
+      ChunkStore store{dir.path.c_str(), cfg};
+      Temp f{a}, g{b};
+      std::vector<ChunkRef> r;
+      _exit(store.status() || store.put(f.fd, r) || store.flush() || store.put(g.fd, r) ? 1 : 0);
+    }
+    int ws;
+    REQUIRE(waitpid(pid, &ws, 0) == pid);
+    REQUIRE((WIFEXITED(ws) && WEXITSTATUS(ws) == 0));
+
+    // the part of b which was written is not synced either and is lost, as after a power failure
+    const std::string pack = dir.path + "/pack-00000000";
+    struct stat st;
+    REQUIRE(stat(pack.c_str(), &st) == 0);
+    REQUIRE((uint64_t)st.st_size > a.size() + (1 << 20));
+    REQUIRE(truncate(pack.c_str(), st.st_size - (1 << 20)) == 0);
+
+    ChunkStore store{dir.path.c_str(), cfg};
+    REQUIRE(store.status() == 0);
+    std::vector<ChunkRef> ra, rb;
+    StoreStats stats;
+    Temp f{a}, g{b};
+    REQUIRE(store.put(f.fd, ra, &stats) == 0);
+    CHECK(stats.new_bytes == 0);  // flushed before the crash
+    CHECK(restored(store, ra) == a);
+    REQUIRE(store.put(g.fd, rb, &stats) == 0);
+    CHECK(stats.new_bytes >= (1 << 20) - (uint64_t)SMALL.max);
+    CHECK(restored(store, rb) == b);
+  }
+
+  TEST_CASE("damaged chunks are detected") {
+    TempDir dir;
+    ChunkStore::Config cfg;
+    cfg.chunker = SMALL;
+    std::vector<ChunkRef> r;
+    {
+      ChunkStore store{dir.path.c_str(), cfg};
+      Temp f{noise(5000, 3)};
+      REQUIRE(store.put(f.fd, r) == 0);
+    }
+    const int fd = open((dir.path + "/pack-00000000").c_str(), O_RDWR);
+    REQUIRE(pwrite(fd, "X", 1, 100) == 1);
+    close(fd);
+
+    ChunkStore store{dir.path.c_str(), cfg};
+    std::vector<uint8_t> out;
+    CHECK(store.get(r[0].digest, out) == EBADMSG);
+  }
+}
@@ -74,3 +74,76 @@ TEST_SUITE("hash 256-bit") {
     REQUIRE(equal(expected, 4, out));
   }
 }
+
+TEST_SUITE("multi-lane") {
+  TEST_CASE("batch of messages of different sizes") {
+    uint8_t data[1024];
+    for (int i{}; i < 1024; i++) data[i] = (uint8_t)(i * 13 + 1);
+
+    const uint64_t sizes[] = {0, 1, 63, 64, 65, 128, 500, 999, 1000, 200, 64};
+    constexpr uint64_t count = sizeof(sizes) / sizeof(sizes[0]);
+    void const* m[count];
+    void* out[count];
+    uint64_t res[count][8];
+    for (uint64_t i{}; i < count; i++) m[i] = data + i, out[i] = res[i];
+
+    for (auto mode : {Streebog::Mode::H512, Streebog::Mode::H256}) {
+      streebog_batch(mode, count, m, sizes, out);
+      for (uint64_t i{}; i < count; i++) {
+        uint64_t expected[8];
+        Streebog{mode}((void*)m[i], sizes[i], expected);
+        REQUIRE(equal(expected, Streebog::digest_size(mode) >> 3, res[i]));
+      }
+    }
+  }
+}
+
+TEST_SUITE("dual digest") {
+  TEST_CASE("one pass gives both hashes") {
+    uint64_t expected512[] = {0x6fcabf2622e6881e, 0xe06915d5f2f19499, 0x1ae60f3b5a47f8da, 0x7613966de4ee0053,
+                              0xb8a2ad4935e85f03, 0xb3e56c497ccd0f62, 0x60642bdcddb90c3f, 0x28fbc9bada033b14},
+             expected256[] = {0x5d9e40904efed29d, 0xb005746d97537fa8, 0x749a66fc28c6cac0, 0x508f7e553c06501d},
+             out512[8], out256[4];
+
+    StreebogDual dual;
+    dual.update(big_m, 10);
+    dual.update(big_m + 10, sizeof(big_m) - 10);
+    dual.finalize(out512, out256);
+
+    REQUIRE(equal(expected512, 8, out512));
+    REQUIRE(equal(expected256, 4, out256));
+  }
+
+  TEST_CASE("lengths around the block size and split updates") {
+    uint8_t data[5000];
+    for (int i{}; i < 5000; i++) data[i] = (uint8_t)(i * 29 + (i >> 7));
+
+    StreebogDual dual;
+    StreebogStream s512{Streebog::Mode::H512}, s256{Streebog::Mode::H256};
+    for (uint64_t size : {0UL, 1UL, 63UL, 64UL, 65UL, 127UL, 128UL, 129UL, 191UL, 1000UL, 4096UL, 4999UL}) {
+      uint64_t expected512[8], expected256[4], out512[8], out256[4], stream512[8], stream256[4];
+      Streebog{Streebog::Mode::H512}(data, size, expected512);
+      Streebog{Streebog::Mode::H256}(data, size, expected256);
+
+      // one call, then pieces which end inside, at and after block boundaries
+      for (uint64_t piece : {size, 1UL, 7UL, 63UL, 64UL, 65UL, 200UL}) {
+        dual.reset(), s512.reset(), s256.reset();
+        uint64_t at{};
+        do {
+          const uint64_t n = (size - at < piece ? size - at : piece);
+          dual.update(data + at, n), s512.update(data + at, n), s256.update(data + at, n);
+          at += n;
+        } while (at < size);
+        dual.finalize(out512, out256);
+        s512.finalize(stream512), s256.finalize(stream256);
+
+        CAPTURE(size);
+        CAPTURE(piece);
+        REQUIRE(equal(expected512, 8, out512));
+        REQUIRE(equal(expected256, 4, out256));
+        REQUIRE(equal(expected512, 8, stream512));
+        REQUIRE(equal(expected256, 4, stream256));
+      }
+    }
+  }
+}
@@ -0,0 +1,139 @@
+/**
+ * @file    test_util.hh
+ * @brief   Temporary files, directories and data shared by the tests
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#pragma once
+#include <fcntl.h>
+#include <ftw.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "doctest.h"
+
+/**
+ * @brief pseudo-random bytes, the same for the same seed
+ */
+inline std::vector<uint8_t> noise(const uint64_t size, uint32_t seed) {
+  std::vector<uint8_t> v(size);
+  for (auto& b : v) seed = seed * 1103515245 + 12345, b = seed >> 24;
+  return v;
+}
+
+/**
+ * @brief anonymous temporary file, unlinked as soon as it is created
+ */
+struct Temp {
+  int fd;
+  Temp() {
+    char tmpl[] = "/tmp/stbg_test_XXXXXX";
+    fd = mkstemp(tmpl);
+    REQUIRE(fd >= 0);
+    unlink(tmpl);
+  }
+  explicit Temp(std::vector<uint8_t> const& data) : Temp() {
+    write_at(0, data);
+    lseek(fd, 0, SEEK_SET);
+  }
+  ~Temp() { close(fd); }
+
+  Temp(const Temp&) = delete;
+  Temp& operator=(const Temp&) = delete;
+
+  void write_at(const uint64_t off, std::vector<uint8_t> const& v) {
+    REQUIRE(pwrite(fd, v.data(), v.size(), off) == (ssize_t)v.size());
+  }
+
+  std::vector<uint8_t> contents() {
+    std::vector<uint8_t> v(lseek(fd, 0, SEEK_END));
+    REQUIRE(pread(fd, v.data(), v.size(), 0) == (ssize_t)v.size());
+    lseek(fd, 0, SEEK_SET);
+    return v;
+  }
+};
+
+/**
+ * @brief temporary file with a name, removed on destruction; fd stays open at the end of the data
+ */
+struct TempFile {
+  std::string path;
+  int fd;
+  explicit TempFile(std::vector<uint8_t> const& data) {
+    char tmpl[] = "/tmp/stbg_test_XXXXXX";
+    fd = mkstemp(tmpl);
+    REQUIRE(fd >= 0);
+    path = tmpl;
+    REQUIRE(write(fd, data.data(), data.size()) == (ssize_t)data.size());
+  }
+  TempFile(TempFile&& o) : path{std::move(o.path)}, fd{std::exchange(o.fd, -1)} {}
+  ~TempFile() {
+    if (fd < 0) return;
+    close(fd);
+    unlink(path.c_str());
+  }
+};
+
+/**
+ * @brief temporary directory, removed with everything in it
+ */
+struct TempDir {
+  std::string path;
+  TempDir() {
+    char tmpl[] = "/tmp/stbg_test_XXXXXX";
+    REQUIRE(mkdtemp(tmpl));
+    path = tmpl;
+  }
+  ~TempDir() {
+    auto remove_entry = [](char const* p, struct stat const*, int, FTW*) { return remove(p); };
+    CHECK(nftw(path.c_str(), remove_entry, 16, FTW_DEPTH | FTW_PHYS) == 0);
+  }
+
+  TempDir(const TempDir&) = delete;
+  TempDir& operator=(const TempDir&) = delete;
+
+  void add(std::string const& name, std::vector<uint8_t> const& data) {
+    const int fd = open((path + '/' + name).c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    REQUIRE(fd >= 0);
+    REQUIRE(write(fd, data.data(), data.size()) == (ssize_t)data.size());
+    close(fd);
+  }
+
+  void link_to(std::string const& name, std::string const& target) {
+    REQUIRE(link((path + '/' + target).c_str(), (path + '/' + name).c_str()) == 0);
+  }
+};
+
+/**
+ * @brief runs f with stdout redirected to a temporary file and returns what was printed
+ */
+template <typename F>
+std::string capture_stdout(F const& f) {
+  char tmpl[] = "/tmp/stbg_out_XXXXXX";
+  const int fd = mkstemp(tmpl), saved = dup(STDOUT_FILENO);
+  REQUIRE(fd >= 0);
+  REQUIRE(saved >= 0);
+  unlink(tmpl);
+  fflush(stdout);
+  dup2(fd, STDOUT_FILENO);
+  f();
+  fflush(stdout);
+  dup2(saved, STDOUT_FILENO);
+  close(saved);
+
+  std::string out(lseek(fd, 0, SEEK_END), '\0');
+  const auto n = pread(fd, out.data(), out.size(), 0);
+  close(fd);
+  REQUIRE(n == (ssize_t)out.size());
+  return out;
+}
@@ -0,0 +1,100 @@
+/**
+ * @file    tree_test.cc
+ * @brief   Tests of the Streebog-Tree hash
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "doctest.h"
+#include "tree.hh"
+#include "test_util.hh"
+
+namespace {
+  constexpr uint64_t LEAF = 4096;
+
+  std::vector<uint8_t> tagged(const uint8_t tag, std::vector<uint8_t> const& a, std::vector<uint8_t> const& b = {}) {
+    std::vector<uint8_t> m{tag};
+    m.insert(m.end(), a.begin(), a.end());
+    m.insert(m.end(), b.begin(), b.end());
+    std::vector<uint8_t> d(64);
+    Streebog s{Streebog::Mode::H512};
+    s(m.data(), m.size(), d.data());
+    return d;
+  }
+
+  std::vector<uint8_t> root(std::vector<uint8_t> const& top, const uint64_t size) {
+    std::vector<uint8_t> h(16);
+    for (int i{}; i < 8; i++) h[i] = LEAF >> (8 * i), h[8 + i] = size >> (8 * i);
+    return tagged(0x02, h, top);
+  }
+
+  std::vector<uint8_t> tree(const int fd, const unsigned threads, const Streebog::Mode mode = Streebog::Mode::H512) {
+    std::vector<uint8_t> d(64);
+    REQUIRE(hash_fd_tree(fd, mode, d.data(), {LEAF, threads}) == 0);
+    d.resize(Streebog::digest_size(mode));
+    return d;
+  }
+}  // namespace
+
+TEST_SUITE("tree") {
+  TEST_CASE("layout") {
+    auto data = noise(2 * LEAF + 10, 7);  // three leaves, the third one carried up
+    Temp f{data};
+    const int fd = f.fd;
+    auto leaf = [&](const uint64_t i) {
+      return tagged(0x00, {data.begin() + i * LEAF, data.begin() + std::min(data.size(), (i + 1) * LEAF)});
+    };
+    CHECK(tree(fd, 1) == root(tagged(0x01, tagged(0x01, leaf(0), leaf(1)), leaf(2)), data.size()));
+
+    Temp empty{{}};
+    CHECK(tree(empty.fd, 1) == root(tagged(0x00, {}), 0));
+  }
+
+  TEST_CASE("the result depends on neither the threads nor the lanes") {
+    auto data = noise(37 * LEAF + 123, 7);
+    Temp f{data};
+    const int fd = f.fd;
+    const auto one = tree(fd, 1);
+    for (unsigned t : {2u, 3u, 8u, 64u}) {
+      lseek(fd, 0, SEEK_SET);
+      CHECK(tree(fd, t) == one);
+    }
+    CHECK(lseek(fd, 0, SEEK_CUR) == (off_t)data.size());
+
+    // not the standard hash, and the 256-bit mode is not a truncation of the 512-bit one
+    std::vector<uint8_t> standard(64);
+    Streebog{Streebog::Mode::H512}(data.data(), data.size(), standard.data());
+    CHECK(one != standard);
+    lseek(fd, 0, SEEK_SET);
+    auto h256 = tree(fd, 4, Streebog::Mode::H256);
+    CHECK(h256.size() == 32);
+    CHECK(memcmp(h256.data(), one.data(), 32));
+
+    // a tree of the data from the current offset
+    lseek(fd, LEAF, SEEK_SET);
+    auto rest = tree(fd, 2);
+    Temp tail{{data.begin() + LEAF, data.end()}};
+    CHECK(tree(tail.fd, 1) == rest);
+  }
+
+  TEST_CASE("errors") {
+    int p[2];
+    REQUIRE(pipe(p) == 0);
+    uint8_t d[64];
+    CHECK(hash_fd_tree(p[0], Streebog::Mode::H512, d) == ESPIPE);
+    close(p[0]), close(p[1]);
+
+    Temp f{noise(100, 7)};
+    CHECK(hash_fd_tree(f.fd, Streebog::Mode::H512, d, {0, 1}) == EINVAL);
+  }
+}
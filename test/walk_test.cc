@@ -0,0 +1,57 @@
+/**
+ * @file    walk_test.cc
+ * @brief   Tests of the -r mode of the stbg utility
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+#include <string>
+#include <vector>
+
+#include "../tool/stbg.hh"
+#include "doctest.h"
+#include "test_util.hh"
+
+TEST_SUITE("walk") {
+  TEST_CASE("trees with more files than descriptors") {
+    TempDir d;
+    std::vector<uint8_t> data(1 << 16);
+    for (uint64_t i{}; i < 300; i++) {
+      char name[16];
+      snprintf(name, sizeof(name), "f%llu", (unsigned long long)(1000 + i));
+      data[0] = (uint8_t)i, data[1] = (uint8_t)(i >> 8);
+      d.add(name, data);
+    }
+
+    struct rlimit saved, low;
+    REQUIRE(getrlimit(RLIMIT_NOFILE, &saved) == 0);
+    low = saved, low.rlim_cur = 64;
+    REQUIRE(setrlimit(RLIMIT_NOFILE, &low) == 0);
+
+    Options opt{.mode = Streebog::Mode::H256, .prog = "stbg"};
+    opt.threads = 1;  // the walker runs far ahead of a single worker
+    char const* roots[] = {d.path.c_str()};
+    int status = -1;
+    auto out = capture_stdout([&] { status = hash_tree(roots, 1, opt); });
+    setrlimit(RLIMIT_NOFILE, &saved);
+
+    CHECK(status == EXIT_SUCCESS);
+    uint64_t lines{};
+    for (auto c : out) lines += (c == '\n');
+    CHECK(lines == 300);
+
+    // names are printed in order, each with the digest of its contents
+    char hex[65];
+    uint8_t digest[32];
+    data[0] = (uint8_t)299, data[1] = (uint8_t)(299 >> 8);
+    Streebog{Streebog::Mode::H256}(data.data(), data.size(), digest);
+    digest_to_hex(digest, Streebog::Mode::H256, hex);
+    CHECK(out.substr(out.size() - 65 - 2 - d.path.size() - 6) == std::string(hex) + "  " + d.path + "/f1299\n");
+  }
+}
@@ -0,0 +1,161 @@
+/**
+ * @file    cache.cc
+ * @brief   --cache of the stbg utility: digests kept in extended attributes or in a sidecar file
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/xattr.h>
+#include <unistd.h>
+
+#include "stbg.hh"
+
+using ui64 = uint64_t;
+
+static constexpr char const* XATTR_NAME[] = {"user.streebog.512", "user.streebog.256"};  ///< indexed by Mode
+static constexpr char const* CKPT_NAME[] = {"user.streebog.ckpt.512", "user.streebog.ckpt.256"};
+static constexpr char CKPT_MAGIC[8] = "stbgck1";
+
+/**
+ * @brief value of a checkpoint attribute, in the byte order of the machine
+ */
+struct CheckpointRecord {
+  char magic[8];
+  uint64_t interval;
+  Checkpoint cp[2];
+};
+
+static ui64 ns(timespec const& t) { return (ui64)t.tv_sec * 1000000000 + t.tv_nsec; }
+
+static DigestCache::Key key_of(struct stat const& st, const Streebog::Mode mode) {
+  return {(ui64)st.st_dev, (ui64)st.st_ino, (uint8_t)mode};
+}
+
+static DigestCache::Entry entry_of(struct stat const& st) {
+  return {(ui64)st.st_size, ns(st.st_mtim), ns(st.st_ctim), (ui64)st.st_ino, {}};
+}
+
+DigestCache::DigestCache(char const* _db) : db{_db ? _db : ""} {
+  if (db.empty()) return;
+  FILE* f = fopen(db.c_str(), "r");
+  if (!f) return;  // no database yet
+
+  unsigned long long dev, ino, size, mtime, ctime;
+  unsigned bits;
+  char hex[129];
+  while (fscanf(f, "%llu %llu %llu %llu %llu %u %128s", &dev, &ino, &size, &mtime, &ctime, &bits, hex) == 7) {
+    const auto mode = (bits == 256 ? Streebog::Mode::H256 : Streebog::Mode::H512);
+    Entry e{size, mtime, ctime, ino, {}};
+    if ((bits == 256 || bits == 512) && strlen(hex) == 2 * Streebog::digest_size(mode) &&
+        hex_to_digest(hex, mode, e.digest))
+      entries[{dev, ino, (uint8_t)mode}] = e;
+  }
+  fclose(f);
+}
+
+DigestCache::~DigestCache() {
+  if (!dirty) return;
+
+  // written next to the old database and renamed over it, so a crash leaves either the old or the new one
+  const std::string tmp = db + ".tmp";
+  FILE* f = fopen(tmp.c_str(), "w");
+  if (!f) return;
+  char hex[129];
+  for (auto& [k, e] : entries) {
+    const auto mode = (Streebog::Mode)k.mode;
+    digest_to_hex(e.digest, mode, hex);
+    fprintf(f, "%llu %llu %llu %llu %llu %u %s\n", (unsigned long long)k.dev, (unsigned long long)k.ino,
+            (unsigned long long)e.size, (unsigned long long)e.mtime_ns, (unsigned long long)e.ctime_ns,
+            (mode == Streebog::Mode::H256 ? 256 : 512), hex);
+  }
+  if (fclose(f) || rename(tmp.c_str(), db.c_str())) unlink(tmp.c_str());
+}
+
+bool DigestCache::lookup(const int fd, struct stat const& st, const Streebog::Mode mode, void* digest) {
+  const auto cur = entry_of(st);
+  const ui64 size = Streebog::digest_size(mode);
+
+  // writing the attribute itself moves ctime, so an attribute is matched by size, mtime and inode only
+  char value[256];
+  const auto n = fgetxattr(fd, XATTR_NAME[(int)mode], value, sizeof(value) - 1);
+  if (n > 0) {
+    value[n] = 0;
+    unsigned long long fsize, mtime, ino;
+    char hex[129];
+    if (sscanf(value, "v2 %llu %llu %llu %128s", &fsize, &mtime, &ino, hex) == 4 &&
+        fsize == cur.size && mtime == cur.mtime_ns && ino == cur.ino && strlen(hex) == 2 * size &&
+        hex_to_digest(hex, mode, digest))
+      return true;
+  }
+
+  if (db.empty()) return false;
+  std::lock_guard lk{mtx};
+  auto it = entries.find(key_of(st, mode));
+  if (it == entries.end()) return false;
+  auto& e = it->second;
+  if (e.size != cur.size || e.mtime_ns != cur.mtime_ns || e.ctime_ns != cur.ctime_ns) return false;
+  memcpy(digest, e.digest, size);
+  return true;
+}
+
+void DigestCache::store(const int fd, struct stat const& before, const Streebog::Mode mode, void const* digest) {
+  // a writer that was active while the file was hashed has moved ctime: the digest may describe no version of it
+  struct stat after;
+  if (fstat(fd, &after) || ns(after.st_ctim) != ns(before.st_ctim) || after.st_size != before.st_size) return;
+
+  auto e = entry_of(before);
+  char hex[129], value[256];
+  digest_to_hex(digest, mode, hex);
+  const int n = snprintf(value, sizeof(value), "v2 %llu %llu %llu %s", (unsigned long long)e.size,
+                         (unsigned long long)e.mtime_ns, (unsigned long long)e.ino, hex);
+  if (!fsetxattr(fd, XATTR_NAME[(int)mode], value, n, 0) || db.empty()) return;
+
+  // no xattrs here (file system, read-only file, foreign owner): the sidecar database takes it
+  memcpy(e.digest, digest, Streebog::digest_size(mode));
+  std::lock_guard lk{mtx};
+  entries[key_of(before, mode)] = e;
+  dirty = true;
+}
+
+/**
+ * @brief reads the checkpoints of the file or, if there are none for this interval, makes an empty record
+ */
+static void load_checkpoints(const int fd, const Streebog::Mode mode, const ui64 interval, CheckpointRecord& r) {
+  if (fgetxattr(fd, CKPT_NAME[(int)mode], &r, sizeof(r)) == sizeof(r) && !memcmp(r.magic, CKPT_MAGIC, 8) &&
+      r.interval == interval)
+    return;
+  memset(&r, 0, sizeof(r));
+  memcpy(r.magic, CKPT_MAGIC, 8), r.interval = interval;
+}
+
+int hash_fd_cached(const int fd, const Streebog::Mode mode, void* digest, Options const& opt) {
+  struct stat st;
+  if ((!opt.cache && !opt.checkpoint) || fstat(fd, &st) || !S_ISREG(st.st_mode) || lseek(fd, 0, SEEK_CUR) != 0)
+    return hash_fd(fd, mode, digest, opt.method);
+
+  if (opt.cache && opt.cache->lookup(fd, st, mode, digest)) return 0;
+
+  CheckpointRecord old, r;
+  int err;
+  if (opt.checkpoint) {
+    load_checkpoints(fd, mode, opt.checkpoint, old);
+    r = old;
+    err = hash_fd_checkpointed(fd, mode, digest, opt.checkpoint, r.cp);
+  } else {
+    err = hash_fd(fd, mode, digest, opt.method);
+  }
+  if (err) return err;
+
+  if (opt.cache) opt.cache->store(fd, st, mode, digest);
+  // only after the digest is stored: the attribute moves ctime, which store() would take for a concurrent writer
+  if (opt.checkpoint && memcmp(&r, &old, sizeof(r))) fsetxattr(fd, CKPT_NAME[(int)mode], &r, sizeof(r), 0);
+  return 0;
+}
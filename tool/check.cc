@@ -0,0 +1,155 @@
+/**
+ * @file    check.cc
+ * @brief   --check mode of the stbg utility: verification of coreutils-style manifests
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "stbg.hh"
+
+using ui64 = uint64_t;
+
+static constexpr ui64 WINDOW = 1ULL << 14;  ///< manifest lines verified at a time
+
+bool parse_check_line(char const* line, ui64 len, Options const& opt, FileJob& job, uint8_t* expected) {
+  if (len && line[len - 1] == '\r') len--;
+  const bool escaped = (len && line[0] == '\\');
+  line += escaped, len -= escaped;
+
+  ui64 hex_len{};
+  while (hex_len < len && isxdigit((unsigned char)line[hex_len])) hex_len++;
+  if (hex_len != 64 && hex_len != 128) return false;
+
+  job.mode = (hex_len == 64 ? Streebog::Mode::H256 : Streebog::Mode::H512);
+  if (opt.mode_set && job.mode != opt.mode) return false;
+  if (len < hex_len + 3 || line[hex_len] != ' ' || (line[hex_len + 1] != ' ' && line[hex_len + 1] != '*'))
+    return false;
+  if (!hex_to_digest(line, job.mode, expected)) return false;
+
+  job.path.clear();
+  for (ui64 i = hex_len + 2; i < len; i++) {
+    if (!escaped || line[i] != '\\') {
+      job.path += line[i];
+      continue;
+    }
+    if (i + 1 == len) return false;  // dangling backslash, as coreutils
+    switch (line[++i]) {
+      case '\\':
+        job.path += '\\';
+        break;
+      case 'n':
+        job.path += '\n';
+        break;
+      case 'r':
+        job.path += '\r';
+        break;
+      default:
+        return false;
+    }
+  }
+
+  return true;
+}
+
+static void print_status(std::string const& name, char const* status) {
+  const bool escape = name.find_first_of("\\\n\r") != std::string::npos;
+  if (escape) putchar('\\');
+  for (auto c : name) {
+    if (escape && c == '\\')
+      fputs("\\\\", stdout);
+    else if (escape && c == '\n')
+      fputs("\\n", stdout);
+    else if (escape && c == '\r')
+      fputs("\\r", stdout);
+    else
+      putchar(c);
+  }
+  printf(": %s\n", status);
+}
+
+int check(char const* manifest, Options const& opt) {
+  const bool in_stdin = !strcmp(manifest, "-");
+  FILE* f = (in_stdin ? stdin : fopen(manifest, "re"));
+  if (!f) {
+    fprintf(stderr, "%s: %s: %s\n", opt.prog, manifest, strerror(errno));
+    return EXIT_FAILURE;
+  }
+
+  std::vector<FileJob> jobs;
+  std::vector<uint8_t> expected(WINDOW << 6);
+  jobs.reserve(WINDOW);
+  ui64 proper{}, improper{}, unreadable{}, mismatched{};
+  bool stop{};
+
+  auto verify = [&] {
+    hash_parallel(jobs, opt, [&](const ui64 i) {
+      auto& j = jobs[i];
+      if (j.err) {
+        fprintf(stderr, "%s: %s: %s\n", opt.prog, j.path.c_str(), strerror(j.err));
+        print_status(j.path, "FAILED open or read");
+        unreadable++;
+      } else if (memcmp(j.digest, &expected[i << 6], Streebog::digest_size(j.mode))) {
+        print_status(j.path, "FAILED");
+        mismatched++;
+      } else {
+        if (!opt.quiet) print_status(j.path, "OK");
+        return true;
+      }
+
+      fflush(stdout);  // failures are reported as soon as they are found
+      stop = opt.fail_fast;
+      return !stop;
+    });
+    fflush(stdout);
+    jobs.clear();
+  };
+
+  // the manifest is never held in full: every window of lines is verified before the next one is read
+  char* line{};
+  size_t cap{};
+  int err{};
+  for (ssize_t len; !stop;) {
+    if ((len = getline(&line, &cap, f)) < 0) {
+      err = (ferror(f) ? errno : 0);
+      break;
+    }
+    if (len && line[len - 1] == '\n') len--;
+
+    jobs.emplace_back();
+    if (!parse_check_line(line, len, opt, jobs.back(), &expected[(jobs.size() - 1) << 6])) {
+      jobs.pop_back();
+      improper += (len > 0);
+      continue;
+    }
+    proper++;
+    if (jobs.size() == WINDOW) verify();
+  }
+  free(line);
+  if (!in_stdin) fclose(f);
+  if (!stop && !jobs.empty()) verify();
+
+  if (err) fprintf(stderr, "%s: %s: %s\n", opt.prog, manifest, strerror(err));
+  if (!proper && !err) {
+    fprintf(stderr, "%s: %s: no properly formatted checksum lines found\n", opt.prog, manifest);
+    return EXIT_FAILURE;
+  }
+
+  auto warn = [&](const ui64 n, char const* one, char const* many) {
+    if (n) fprintf(stderr, "%s: WARNING: %llu %s\n", opt.prog, (unsigned long long)n, n == 1 ? one : many);
+  };
+  warn(improper, "line is improperly formatted", "lines are improperly formatted");
+  warn(unreadable, "listed file could not be read", "listed files could not be read");
+  warn(mismatched, "computed checksum did NOT match", "computed checksums did NOT match");
+
+  return (err || unreadable || mismatched ? EXIT_FAILURE : EXIT_SUCCESS);
+}
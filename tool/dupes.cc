@@ -0,0 +1,202 @@
+/**
+ * @file    dupes.cc
+ * @brief   --dupes mode of the stbg utility: finding duplicate files in stages
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+
+#include "stbg.hh"
+
+using ui64 = uint64_t;
+
+static constexpr ui64 EDGE = 1ULL << 16;  ///< bytes taken from each end of a file by the second stage
+
+namespace {
+  struct Candidate {
+    std::string path;
+    ui64 size, dev, ino;
+    int err;
+    alignas(32) uint8_t digest[32];  ///< edge digest, then full digest
+  };
+
+  struct Collector {
+    Options const& opt;
+    std::vector<Candidate> files;
+    int status{EXIT_SUCCESS};
+
+    void fail(std::string const& path, const int err) {
+      fprintf(stderr, "%s: %s: %s\n", opt.prog, path.c_str(), strerror(err));
+      status = EXIT_FAILURE;
+    }
+
+    /**
+     * @brief collects the paths of the regular files under a root, or the root itself if it is not a directory;
+     * symbolic links are not followed
+     */
+    void add(char const* root) {
+      const int fd = open(root, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+      if (fd < 0) {
+        // ENOTDIR and ELOOP (a symbolic link): stat_all() keeps the root only if it is a regular file
+        if (errno == ENOTDIR || errno == ELOOP)
+          files.push_back({root, 0, 0, 0, 0, {}});
+        else
+          fail(root, errno);
+        return;
+      }
+      const std::string path = root;
+      walk_dir(
+          fd, (path.back() == '/' ? path : path + '/'),
+          [&](int, char const*, std::string p) { files.push_back({std::move(p), 0, 0, 0, 0, {}}); },
+          [&](std::string const& p, const int err) { fail(p, err); });
+    }
+
+    /**
+     * @brief takes the sizes and inodes of the collected files on the pool, then drops the ones which failed, the
+     * empty ones and whatever is not a regular file
+     */
+    void stat_all() {
+      parallel_for(files.size(), opt, [&](const ui64 i) {
+        auto& c = files[i];
+        struct stat st;
+        if (lstat(c.path.c_str(), &st))
+          c.err = errno;
+        else if (S_ISREG(st.st_mode))
+          c.size = st.st_size, c.dev = st.st_dev, c.ino = st.st_ino;
+      });
+      for (auto& c : files)
+        if (c.err) fail(c.path, c.err);
+      files.erase(std::remove_if(files.begin(), files.end(), [](Candidate const& c) { return c.err || !c.size; }),
+                  files.end());
+    }
+  };
+
+  /**
+   * @brief Streebog-256 of the first and the last EDGE bytes (of the whole file if it is not longer than 2 * EDGE)
+   */
+  int hash_edges(Candidate& c, uint8_t* buff) {
+    const int fd = open(c.path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return errno;
+
+    const ui64 head = (c.size < 2 * EDGE ? c.size : EDGE);
+    const ui64 want = (c.size < 2 * EDGE ? c.size : 2 * EDGE);
+    ui64 got{};
+    int err{};
+    while (got < want) {
+      const ui64 off = (got < head ? got : c.size - EDGE + (got - head));
+      const ui64 len = (got < head ? head - got : want - got);
+      auto n = pread(fd, buff + got, len, off);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) {
+        err = (n ? errno : EIO);  // EIO: the file has shrunk since it was stat()ed
+        break;
+      }
+      got += n;
+    }
+    close(fd);
+    if (err) return err;
+
+    Streebog{Streebog::Mode::H256}(buff, got, c.digest);
+    return 0;
+  }
+
+  /**
+   * @brief splits every group of indices by the digest of its files, dropping the files which are left alone
+   */
+  using Groups = std::vector<std::vector<ui64>>;
+
+  Groups split(std::vector<Candidate> const& files, Groups const& groups) {
+    Groups out;
+    for (auto& g : groups) {
+      std::map<std::string, std::vector<ui64>> by;
+      for (auto i : g)
+        if (!files[i].err) by[std::string((char const*)files[i].digest, 32)].push_back(i);
+      for (auto& [_, v] : by)
+        if (v.size() > 1) out.push_back(std::move(v));
+    }
+    return out;
+  }
+}  // namespace
+
+int find_dupes(char const* const* roots, const int count, Options const& opt) {
+  Collector col{opt, {}};
+  for (int i{}; i < count; i++) col.add(roots[i]);
+  col.stat_all();
+  auto& files = col.files;
+
+  // a file reached by several paths (hard links, repeated roots) is not a duplicate of itself
+  std::sort(files.begin(), files.end(), [](Candidate const& a, Candidate const& b) {
+    if (a.size != b.size) return a.size > b.size;
+    if (a.dev != b.dev) return a.dev < b.dev;
+    return a.ino != b.ino ? a.ino < b.ino : a.path < b.path;
+  });
+  files.erase(std::unique(files.begin(), files.end(),
+                          [](Candidate const& a, Candidate const& b) { return a.dev == b.dev && a.ino == b.ino; }),
+              files.end());
+
+  // stage 1: size
+  Groups groups;
+  for (ui64 i{}, j; i < files.size(); i = j) {
+    for (j = i + 1; j < files.size() && files[j].size == files[i].size;) j++;
+    if (j - i < 2) continue;
+    groups.emplace_back();
+    for (ui64 k = i; k < j; k++) groups.back().push_back(k);
+  }
+
+  // stage 2: both ends of the file
+  std::vector<ui64> todo;
+  for (auto& g : groups) todo.insert(todo.end(), g.begin(), g.end());
+  parallel_for(todo.size(), opt, [&](const ui64 k) {
+    thread_local std::vector<uint8_t> buff(2 * EDGE);
+    auto& c = files[todo[k]];
+    c.err = hash_edges(c, buff.data());
+  });
+  groups = split(files, groups);
+
+  // stage 3: full hash of the files longer than their edges, largest first on the hashing pool
+  std::vector<FileJob> jobs;
+  std::vector<ui64> job_of;
+  for (auto& g : groups)
+    for (auto i : g)
+      if (files[i].size > 2 * EDGE) jobs.push_back({files[i].path, Streebog::Mode::H256, 0, {}}), job_of.push_back(i);
+  hash_parallel(jobs, opt, [&](const ui64 j) {
+    auto& c = files[job_of[j]];
+    c.err = jobs[j].err;
+    memcpy(c.digest, jobs[j].digest, 32);
+    return true;
+  });
+  groups = split(files, groups);
+
+  for (auto& c : files)
+    if (c.err) col.fail(c.path, c.err);
+
+  // one line per file: group number, size, Streebog-256 and the name (see print_field()), tab separated
+  auto by_path = [&](const ui64 a, const ui64 b) { return files[a].path < files[b].path; };
+  for (auto& g : groups) std::sort(g.begin(), g.end(), by_path);
+  std::sort(groups.begin(), groups.end(), [&](auto const& a, auto const& b) { return by_path(a[0], b[0]); });
+  char hex[65];
+  ui64 id{};
+  for (auto& g : groups) {
+    id++;
+    for (auto i : g) {
+      digest_to_hex(files[i].digest, Streebog::Mode::H256, hex);
+      printf("%llu\t%llu\t%s\t", (unsigned long long)id, (unsigned long long)files[i].size, hex);
+      print_field(files[i].path);
+      putchar('\n');
+    }
+  }
+
+  return col.status;
+}
@@ -0,0 +1,257 @@
+/**
+ * @file    parallel.cc
+ * @brief   Parallel hashing of files for the stbg utility
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "stbg.hh"
+
+using ui64 = uint64_t;
+
+static constexpr ui64 SMALL_FILE = 1ULL << 16;  ///< smaller files are hashed in batches
+static constexpr ui64 SMALL_BATCH = 32;         ///< max number of files in a batch
+static constexpr ui64 URING_FILE = 1ULL << 22;  ///< with --io=uring, smaller files share one reader in groups
+static constexpr ui64 URING_BATCH = 16;         ///< max number of files in such a group
+
+static void hash_job(FileJob& job, Options const& opt) {
+  if (job.path == "-") {
+    job.err = hash_fd(STDIN_FILENO, job.mode, job.digest, opt.method);
+    return;
+  }
+
+  const int fd = open(job.path.c_str(), O_RDONLY | O_CLOEXEC);
+  job.err = (fd < 0 ? errno : hash_fd_cached(fd, job.mode, job.digest, opt));
+  if (fd >= 0) close(fd);
+}
+
+/**
+ * @brief opens the files of a group; the ones found in the cache get their digests and fd -1, like the ones which
+ * cannot be opened (these get err)
+ */
+static void open_group(std::vector<FileJob>& jobs, ui64 const* idx, const ui64 count, DigestCache* cache,
+                       std::vector<int>& fds, std::vector<struct stat>& st) {
+  for (ui64 k{}; k < count; k++) {
+    auto& j = jobs[idx[k]];
+    if ((fds[k] = open(j.path.c_str(), O_RDONLY | O_CLOEXEC)) < 0) {
+      j.err = errno;
+      continue;
+    }
+    if (cache && !fstat(fds[k], &st[k]) && S_ISREG(st[k].st_mode) && cache->lookup(fds[k], st[k], j.mode, j.digest)) {
+      close(fds[k]);
+      fds[k] = -1;
+    }
+  }
+}
+
+/**
+ * @brief stores the digests of a group hashed without errors in the cache and closes the files
+ */
+static void close_group(std::vector<FileJob>& jobs, ui64 const* idx, const ui64 count, DigestCache* cache,
+                        std::vector<int> const& fds, std::vector<struct stat> const& st) {
+  for (ui64 k{}; k < count; k++) {
+    if (fds[k] < 0) continue;
+    auto& j = jobs[idx[k]];
+    if (cache && !j.err && S_ISREG(st[k].st_mode)) cache->store(fds[k], st[k], j.mode, j.digest);
+    close(fds[k]);
+  }
+}
+
+/**
+ * @brief reads a group of small files and hashes them together with the multi-lane kernel
+ */
+static void hash_small(std::vector<FileJob>& jobs, ui64 const* idx, const ui64 count, DigestCache* cache) {
+  std::vector<std::vector<uint8_t>> data(count);
+  std::vector<int> fds(count);  ///< kept open for the cache until the digests are stored
+  std::vector<struct stat> st(count);
+  open_group(jobs, idx, count, cache, fds, st);
+  for (ui64 k{}; k < count; k++) {
+    if (fds[k] < 0) continue;
+    data[k].resize(SMALL_FILE);
+    ui64 size{};
+    for (ssize_t n; size < data[k].size();) {
+      n = read(fds[k], data[k].data() + size, data[k].size() - size);
+      if (n < 0 && errno == EINTR) continue;
+      if (n < 0) jobs[idx[k]].err = errno;
+      if (n <= 0) break;
+      size += n;
+      if (size == data[k].size()) data[k].resize(size << 1);  // the file has grown since stat()
+    }
+    data[k].resize(size);
+  }
+
+  for (auto mode : {Streebog::Mode::H256, Streebog::Mode::H512}) {
+    std::vector<void const*> m;
+    std::vector<ui64> size;
+    std::vector<void*> out;
+    for (ui64 k{}; k < count; k++) {
+      auto& j = jobs[idx[k]];
+      if (fds[k] < 0 || j.err || j.mode != mode) continue;
+      m.push_back(data[k].data()), size.push_back(data[k].size()), out.push_back(j.digest);
+    }
+    if (!m.empty()) streebog_batch(mode, m.size(), m.data(), size.data(), out.data());
+  }
+  close_group(jobs, idx, count, cache, fds, st);
+}
+
+/**
+ * @brief hashes a group of files through one io_uring reader, which keeps reads of all of them in flight
+ */
+static void hash_uring(std::vector<FileJob>& jobs, ui64 const* idx, const ui64 count, DigestCache* cache) {
+  std::vector<int> fds(count);
+  std::vector<struct stat> st(count);
+  open_group(jobs, idx, count, cache, fds, st);
+  for (auto mode : {Streebog::Mode::H256, Streebog::Mode::H512}) {
+    std::vector<int> fd, err;
+    std::vector<void*> out;
+    std::vector<ui64> which;
+    for (ui64 k{}; k < count; k++)
+      if (fds[k] >= 0 && jobs[idx[k]].mode == mode)
+        fd.push_back(fds[k]), out.push_back(jobs[idx[k]].digest), which.push_back(k);
+    if (fd.empty()) continue;
+    err.resize(fd.size());
+    hash_fds(fd.size(), fd.data(), mode, out.data(), err.data());
+    for (ui64 i{}; i < which.size(); i++) jobs[idx[which[i]]].err = err[i];
+  }
+  close_group(jobs, idx, count, cache, fds, st);
+}
+
+void parallel_for(const ui64 count, Options const& opt, std::function<void(ui64)> const& f) {
+  ui64 threads = (opt.threads ? opt.threads : std::thread::hardware_concurrency());
+  threads = (threads < count ? threads : count);
+  std::atomic<ui64> next{};
+  std::vector<std::thread> pool;
+  for (ui64 t{}; t < (threads ? threads : 1); t++)
+    pool.emplace_back([&] {
+      for (ui64 i; (i = next.fetch_add(1, std::memory_order_relaxed)) < count;) f(i);
+    });
+  for (auto& t : pool) t.join();
+}
+
+void hash_parallel(std::vector<FileJob>& jobs, Options const& opt, std::function<bool(ui64)> const& on_done) {
+  const ui64 n = jobs.size();
+
+  // largest files go first, so the longest job never starts last; pipes and other unknown sizes count as large.
+  // The sizes are taken on the pool too, so a long list does not wait on one stat() after another
+  std::vector<ui64> order(n), size(n);
+  parallel_for(n, opt, [&](const ui64 i) {
+    struct stat st;
+    const bool known = jobs[i].path != "-" && !stat(jobs[i].path.c_str(), &st) && S_ISREG(st.st_mode);
+    order[i] = i, size[i] = (known ? st.st_size : ~0ULL);
+  });
+  std::stable_sort(order.begin(), order.end(), [&](const ui64 a, const ui64 b) { return size[a] > size[b]; });
+
+  // small files are read and hashed in batches; with --io=uring (and no checkpoints) medium ones go in groups through
+  // one reader, so the reads of several files are in flight at once
+  enum Kind { SINGLE, SMALL, URING };
+  const bool uring = (opt.method == ReadMethod::Uring && !opt.checkpoint);
+  auto kind = [&](const ui64 s) { return s < SMALL_FILE ? SMALL : uring && s < URING_FILE ? URING : SINGLE; };
+  struct Unit {
+    ui64 first, count;  ///< range of order
+    Kind kind;
+  };
+  std::vector<Unit> units;
+  for (ui64 k{}; k < n; k++) {
+    const Kind kd = kind(size[order[k]]);
+    const ui64 max = (kd == SMALL ? SMALL_BATCH : URING_BATCH);
+    if (kd != SINGLE && !units.empty() && units.back().kind == kd && units.back().count < max)
+      units.back().count++;
+    else
+      units.push_back({k, 1, kd});
+  }
+
+  ui64 threads = (opt.threads ? opt.threads : std::thread::hardware_concurrency());
+  threads = (threads < units.size() ? threads : units.size());
+  threads = (threads ? threads : 1);
+
+  std::atomic<ui64> next{};
+  std::atomic<bool> stop{};
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::vector<ui64> completed;
+
+  std::vector<std::thread> workers;
+  for (ui64 t{}; t < threads; t++)
+    workers.emplace_back([&] {
+      for (ui64 u; !stop.load(std::memory_order_relaxed) && (u = next.fetch_add(1)) < units.size();) {
+        auto [first, count, kd] = units[u];
+        if (kd == SINGLE)
+          hash_job(jobs[order[first]], opt);
+        else if (kd == SMALL)
+          hash_small(jobs, &order[first], count, opt.cache);
+        else
+          hash_uring(jobs, &order[first], count, opt.cache);
+
+        std::lock_guard lk{mtx};
+        completed.insert(completed.end(), &order[first], &order[first] + count);
+        cv.notify_one();
+      }
+    });
+
+  std::vector<bool> done(opt.keep_order ? n : 0);
+  std::vector<ui64> batch;
+  for (ui64 reported{}, in_order{}; reported < n && !stop;) {
+    {
+      std::unique_lock lk{mtx};
+      cv.wait(lk, [&] { return !completed.empty(); });
+      batch.swap(completed);
+    }
+
+    for (auto i : batch) {
+      if (opt.keep_order) {
+        for (done[i] = true; in_order < n && done[in_order] && !stop; in_order++, reported++)
+          if (!on_done(in_order)) stop = true;
+      } else if (!stop) {
+        reported++;
+        if (!on_done(i)) stop = true;
+      }
+    }
+    batch.clear();
+  }
+
+  stop = true;
+  for (auto& w : workers) w.join();
+}
+
+void print_field(std::string const& name) {
+  for (auto c : name) {
+    if (c == '\\' || c == '\t' || c == '\r' || c == '\n')
+      putchar('\\'), putchar(c == '\t' ? 't' : c == '\r' ? 'r' : c == '\n' ? 'n' : '\\');
+    else
+      putchar(c);
+  }
+}
+
+void print_line(char const* hex, std::string const& name) {
+  const bool escape = name.find_first_of("\\\n\r") != std::string::npos;
+  if (escape) putchar('\\');
+  fputs(hex, stdout);
+  fputs("  ", stdout);
+  for (auto c : name) {
+    if (!escape)
+      putchar(c);
+    else if (c == '\\')
+      fputs("\\\\", stdout);
+    else if (c == '\n')
+      fputs("\\n", stdout);
+    else if (c == '\r')
+      fputs("\\r", stdout);
+    else
+      putchar(c);
+  }
+  putchar('\n');
+}
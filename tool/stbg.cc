@@ -0,0 +1,356 @@
+/**
+ * @file    stbg.cc
+ * @brief   stbg - command-line utility printing GOST 34.11-2018 hashes of files
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <memory>
+
+#include "stbg.hh"
+#include "tree.hh"
+
+#ifndef STBG_DEFAULT_BITS
+#define STBG_DEFAULT_BITS 512
+#endif
+
+static int copy(char const* src, char const* dest, Options const& opt) {
+  const bool in_stdin = !strcmp(src, "-");
+  const int fd = (in_stdin ? STDIN_FILENO : open(src, O_RDONLY | O_CLOEXEC));
+  if (fd < 0) {
+    fprintf(stderr, "%s: %s: %s\n", opt.prog, src, strerror(errno));
+    return EXIT_FAILURE;
+  }
+  const int out = open(dest, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+  if (out < 0) {
+    fprintf(stderr, "%s: %s: %s\n", opt.prog, dest, strerror(errno));
+    if (!in_stdin) close(fd);
+    return EXIT_FAILURE;
+  }
+
+  alignas(32) uint8_t digest[64];
+  int err = hash_copy(fd, out, opt.mode, digest);
+  if (close(out) && !err) err = errno;  // NFS and friends report write errors on close
+  if (!in_stdin) close(fd);
+  if (err) {
+    fprintf(stderr, "%s: %s -> %s: %s\n", opt.prog, src, dest, strerror(err));
+    return EXIT_FAILURE;
+  }
+
+  char hex[129];
+  digest_to_hex(digest, opt.mode, hex);
+  print_line(hex, src);
+  return EXIT_SUCCESS;
+}
+
+static int tree(char const* path, Options const& opt) {
+  const bool in_stdin = !strcmp(path, "-");
+  const int fd = (in_stdin ? STDIN_FILENO : open(path, O_RDONLY | O_CLOEXEC));
+  if (fd < 0) {
+    fprintf(stderr, "%s: %s: %s\n", opt.prog, path, strerror(errno));
+    return EXIT_FAILURE;
+  }
+
+  alignas(32) uint8_t digest[64];
+  TreeConfig cfg;
+  cfg.threads = opt.threads;
+  const int err = hash_fd_tree(fd, opt.mode, digest, cfg);
+  if (!in_stdin) close(fd);
+  if (err) {
+    fprintf(stderr, "%s: %s: %s\n", opt.prog, path, strerror(err));
+    return EXIT_FAILURE;
+  }
+
+  // tagged rather than in the sha256sum format, so that it is never taken for a standard digest (-c rejects it)
+  char hex[129];
+  digest_to_hex(digest, opt.mode, hex);
+  printf("STREEBOG-TREE-%d (%s) = %s\n", (opt.mode == Streebog::Mode::H256 ? 256 : 512), path, hex);
+  return EXIT_SUCCESS;
+}
+
+static int segments(char const* path, const uint64_t segment, Options const& opt) {
+  const bool in_stdin = !strcmp(path, "-");
+  const int fd = (in_stdin ? STDIN_FILENO : open(path, O_RDONLY | O_CLOEXEC));
+  if (fd < 0) {
+    fprintf(stderr, "%s: %s: %s\n", opt.prog, path, strerror(errno));
+    return EXIT_FAILURE;
+  }
+
+  alignas(32) uint8_t digest[64];
+  std::vector<uint8_t> parts;
+  const int err = hash_fd_segments(fd, opt.mode, digest, segment, parts, {}, opt.threads);
+  if (!in_stdin) close(fd);
+  if (err) {
+    fprintf(stderr, "%s: %s: %s\n", opt.prog, path, strerror(err));
+    return EXIT_FAILURE;
+  }
+
+  // segment lines are not in the sha256sum format: -c checks the whole file and only warns about them
+  char hex[129];
+  const uint64_t d = Streebog::digest_size(opt.mode);
+  for (uint64_t i{}; i < parts.size() / d; i++) {
+    digest_to_hex(parts.data() + i * d, opt.mode, hex);
+    printf("%llu\t%s\t", (unsigned long long)(i * segment), hex);
+    print_field(path);
+    putchar('\n');
+  }
+  digest_to_hex(digest, opt.mode, hex);
+  print_line(hex, path);
+  return EXIT_SUCCESS;
+}
+
+/**
+ * @brief parses a decimal number in [min, max]; signs, spaces, trailing garbage and overflow are rejected
+ */
+static bool parse_number(char const* s, const uint64_t min, const uint64_t max, uint64_t& out) {
+  if (*s < '0' || *s > '9') return false;  // strtoull() would skip spaces and negate "-1"
+  char* end;
+  errno = 0;
+  const auto v = strtoull(s, &end, 10);
+  if (errno || *end || v < min || v > max) return false;
+  out = v;
+  return true;
+}
+
+static void usage(FILE* f, const char* prog) {
+  fprintf(f,
+          "Usage: %s [OPTION]... [FILE]...\n"
+          "Print GOST 34.11-2018 (Streebog) hashes of FILEs.\n"
+          "With no FILE, or when FILE is -, read standard input.\n"
+          "\n"
+          "  -a, --algorithm=BITS  256 or 512 (default %d)\n"
+          "  -c, --check           read hashes from the FILEs and check them\n"
+          "      --io=METHOD       auto, read, mmap, direct or uring (default auto)\n"
+          "  -r, --recursive       hash every regular file under the directories given\n"
+          "  -j, --jobs=N          number of hashing threads (default - one per CPU)\n"
+          "      --tee=DEST        copy the single FILE to DEST while hashing it\n"
+          "      --dupes           list duplicate regular files under the directories given (default .)\n"
+          "                        as GROUP, SIZE, 256-bit HASH and NAME separated by tabs\n"
+          "      --cache           reuse and keep digests of unchanged files in xattrs\n"
+          "      --cache-db=FILE   --cache with FILE for files whose attributes cannot be set\n"
+          "      --no-cache        hash every file, cancels --cache and --cache-db\n"
+          "      --checkpoint[=MIB]  for files that only grow: keep checkpoints every MIB (64) in xattrs\n"
+          "                        and hash only what has been appended since the last run\n"
+          "      --segments[=MIB]  also print the hash of every MIB (64) bytes of each FILE, computed in the same\n"
+          "                        pass, as OFFSET, HASH and NAME separated by tabs\n"
+          "      --tree            NON-STANDARD: hash each FILE as a tree of 1MB leaves on all CPUs;\n"
+          "                        fast for huge files, but the result is not a GOST 34.11-2018 hash\n"
+          "  -h, --help            display this help and exit\n"
+          "\n"
+          "-c, -r, --dupes, --tee, --segments and --tree exclude each other. --cache, --cache-db and\n"
+          "--checkpoint only apply to plain hashing and -r.\n"
+          "\n"
+          "The following options are useful only when verifying hashes:\n"
+          "      --keep-order      report files in the order of the manifest\n"
+          "      --fail-fast       stop at the first file which fails\n"
+          "      --quiet           don't print OK for each successfully verified file\n"
+          "\n"
+          "Output lines are compatible with sha256sum: HASH, two spaces, file name.\n",
+          prog, STBG_DEFAULT_BITS);
+}
+
+int main(int argc, char** argv) {
+  enum {
+    OPT_IO = 256,
+    OPT_KEEP_ORDER,
+    OPT_FAIL_FAST,
+    OPT_QUIET,
+    OPT_TEE,
+    OPT_CACHE,
+    OPT_CACHE_DB,
+    OPT_NO_CACHE,
+    OPT_CHECKPOINT,
+    OPT_DUPES,
+    OPT_TREE,
+    OPT_SEGMENTS,
+  };
+  static const option longopts[] = {{"algorithm", required_argument, nullptr, 'a'},
+                                    {"check", no_argument, nullptr, 'c'},
+                                    {"io", required_argument, nullptr, OPT_IO},
+                                    {"jobs", required_argument, nullptr, 'j'},
+                                    {"keep-order", no_argument, nullptr, OPT_KEEP_ORDER},
+                                    {"fail-fast", no_argument, nullptr, OPT_FAIL_FAST},
+                                    {"quiet", no_argument, nullptr, OPT_QUIET},
+                                    {"recursive", no_argument, nullptr, 'r'},
+                                    {"tee", required_argument, nullptr, OPT_TEE},
+                                    {"cache", no_argument, nullptr, OPT_CACHE},
+                                    {"cache-db", required_argument, nullptr, OPT_CACHE_DB},
+                                    {"no-cache", no_argument, nullptr, OPT_NO_CACHE},
+                                    {"checkpoint", optional_argument, nullptr, OPT_CHECKPOINT},
+                                    {"dupes", no_argument, nullptr, OPT_DUPES},
+                                    {"tree", no_argument, nullptr, OPT_TREE},
+                                    {"segments", optional_argument, nullptr, OPT_SEGMENTS},
+                                    {"help", no_argument, nullptr, 'h'},
+                                    {nullptr, 0, nullptr, 0}};
+
+  Options opt{.mode = (STBG_DEFAULT_BITS == 256 ? Streebog::Mode::H256 : Streebog::Mode::H512), .prog = argv[0]};
+  bool check_mode{}, recursive{}, dupes{}, tree_mode{};
+  char const* tee{};
+  bool use_cache{};
+  uint64_t segment{};
+  char const* cache_db{};
+
+  for (int c; (c = getopt_long(argc, argv, "a:cj:rh", longopts, nullptr)) != -1;) {
+    switch (c) {
+      case 'a':
+        if (!strcmp(optarg, "256"))
+          opt.mode = Streebog::Mode::H256;
+        else if (!strcmp(optarg, "512"))
+          opt.mode = Streebog::Mode::H512;
+        else {
+          fprintf(stderr, "%s: invalid algorithm '%s', expected 256 or 512\n", argv[0], optarg);
+          return EXIT_FAILURE;
+        }
+        opt.mode_set = true;
+        break;
+      case 'c':
+        check_mode = true;
+        break;
+      case 'r':
+        recursive = true;
+        break;
+      case 'j': {
+        uint64_t n;
+        if (!parse_number(optarg, 1, 4096, n)) {
+          fprintf(stderr, "%s: invalid number of jobs '%s', expected 1 to 4096\n", argv[0], optarg);
+          return EXIT_FAILURE;
+        }
+        opt.threads = n;
+        break;
+      }
+      case OPT_KEEP_ORDER:
+        opt.keep_order = true;
+        break;
+      case OPT_FAIL_FAST:
+        opt.fail_fast = true;
+        break;
+      case OPT_QUIET:
+        opt.quiet = true;
+        break;
+      case OPT_TEE:
+        tee = optarg;
+        break;
+      case OPT_CACHE:
+        use_cache = true;
+        break;
+      case OPT_CACHE_DB:
+        use_cache = true, cache_db = optarg;
+        break;
+      case OPT_NO_CACHE:
+        use_cache = false, cache_db = nullptr;
+        break;
+      case OPT_CHECKPOINT:
+        opt.checkpoint = 64;
+        if (optarg && !parse_number(optarg, 1, UINT64_MAX >> 20, opt.checkpoint)) {
+          fprintf(stderr, "%s: invalid checkpoint interval '%s'\n", argv[0], optarg);
+          return EXIT_FAILURE;
+        }
+        opt.checkpoint <<= 20;
+        break;
+      case OPT_DUPES:
+        dupes = true;
+        break;
+      case OPT_TREE:
+        tree_mode = true;
+        break;
+      case OPT_SEGMENTS:
+        segment = 64;
+        if (optarg && !parse_number(optarg, 1, UINT64_MAX >> 20, segment)) {
+          fprintf(stderr, "%s: invalid segment size '%s'\n", argv[0], optarg);
+          return EXIT_FAILURE;
+        }
+        segment <<= 20;
+        break;
+      case OPT_IO: {
+        static const char* names[] = {"auto", "read", "mmap", "direct", "uring"};
+        int i{};
+        while (i < (int)ReadMethod::__COUNT__ && strcmp(optarg, names[i])) i++;
+        if (i == (int)ReadMethod::__COUNT__) {
+          fprintf(stderr, "%s: invalid I/O method '%s'\n", argv[0], optarg);
+          return EXIT_FAILURE;
+        }
+        opt.method = (ReadMethod)i;
+        break;
+      }
+      case 'h':
+        usage(stdout, argv[0]);
+        return EXIT_SUCCESS;
+      default:
+        usage(stderr, argv[0]);
+        return EXIT_FAILURE;
+    }
+  }
+
+  if (check_mode + recursive + dupes + tree_mode + (segment != 0) + (tee != nullptr) > 1) {
+    fprintf(stderr, "%s: only one of -c, -r, --dupes, --tee, --segments and --tree can be given\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  // -c verifies the contents, so it does not take a digest on trust from an attribute anyone can forge with touch;
+  // the other modes do not hash through hash_fd_cached() at all
+  if ((use_cache || opt.checkpoint) && (check_mode || dupes || tree_mode || segment || tee)) {
+    fprintf(stderr, "%s: --cache, --cache-db and --checkpoint only apply to plain hashing and -r\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  static char const* const stdin_only[] = {"-"};
+  char const* const* files = (optind < argc ? argv + optind : stdin_only);
+  const int count = (optind < argc ? argc - optind : 1);
+
+  std::unique_ptr<DigestCache> cache{use_cache ? new DigestCache{cache_db} : nullptr};
+  opt.cache = cache.get();
+
+  int status = EXIT_SUCCESS;
+  if (check_mode) {
+    for (int i{}; i < count; i++) status |= check(files[i], opt);
+    return status;
+  }
+  if (dupes) {
+    static char const* const cwd[] = {"."};
+    return (optind < argc ? find_dupes(files, count, opt) : find_dupes(cwd, 1, opt));
+  }
+  if (tree_mode) {
+    for (int i{}; i < count; i++) status |= tree(files[i], opt);
+    return status;
+  }
+  if (segment) {
+    for (int i{}; i < count; i++) status |= segments(files[i], segment, opt);
+    return status;
+  }
+  if (recursive) return hash_tree(files, count, opt);
+  if (tee) {
+    if (count != 1) {
+      fprintf(stderr, "%s: --tee needs exactly one FILE\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+    return copy(files[0], tee, opt);
+  }
+
+  std::vector<FileJob> jobs(count);
+  for (int i{}; i < count; i++) jobs[i].path = files[i], jobs[i].mode = opt.mode;
+
+  opt.keep_order = true;  // the output follows the order of arguments
+  char hex[129];
+  hash_parallel(jobs, opt, [&](const uint64_t i) {
+    if (jobs[i].err) {
+      fflush(stdout);
+      fprintf(stderr, "%s: %s: %s\n", argv[0], files[i], strerror(jobs[i].err));
+      status = EXIT_FAILURE;
+    } else {
+      digest_to_hex(jobs[i].digest, opt.mode, hex);
+      print_line(hex, jobs[i].path);
+    }
+    return true;
+  });
+
+  return status;
+}
@@ -0,0 +1,198 @@
+/**
+ * @file    stbg.hh
+ * @brief   Internal interfaces of the stbg utility
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#pragma once
+#include <stdint.h>
+
+#include <sys/stat.h>
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "file.hh"
+
+class DigestCache;
+
+/**
+ * @brief command-line options shared by all modes of the utility
+ */
+struct Options {
+  Streebog::Mode mode;               ///< -a
+  bool mode_set{};                   ///< -a was given explicitly
+  ReadMethod method{ReadMethod::Auto};  ///< --io
+  unsigned threads{};                ///< -j, 0 - one per hardware thread
+  bool keep_order{};                 ///< --keep-order
+  bool fail_fast{};                  ///< --fail-fast
+  bool quiet{};                      ///< --quiet
+  DigestCache* cache{};              ///< --cache, --cache-db
+  uint64_t checkpoint{};             ///< --checkpoint in bytes, 0 - off
+  char const* prog;                  ///< argv[0] for messages
+};
+
+/**
+ * @brief digests remembered between runs, see --cache
+ * @details
+ * A digest is kept in the user.streebog.256 or user.streebog.512 attribute of the file as
+ * "v2 SIZE MTIME_NS INODE HEX". Setting an attribute moves the ctime of the file, so attributes are matched by size,
+ * mtime and inode only; as mtime can be set by anyone owning the file, --check never consults the cache. Where
+ * attributes cannot be set and a sidecar database is given, the digest goes there keyed by device and inode and is
+ * matched by size, mtime and ctime. A digest is stored only if the ctime and size of the file are the same after
+ * hashing as before, so a file written concurrently is never cached.
+ */
+class DigestCache {
+ public:
+  struct Key {
+    uint64_t dev, ino;
+    uint8_t mode;
+    bool operator==(Key const&) const = default;
+  };
+  struct Entry {
+    uint64_t size, mtime_ns, ctime_ns, ino;
+    uint8_t digest[64];
+  };
+
+  /**
+   * @param db sidecar database path, nullptr - attributes only
+   */
+  explicit DigestCache(char const* db);
+  ~DigestCache();  ///< writes the database back if it has changed
+
+  /**
+   * @brief finds a digest of the file in the state st describes
+   * @return false if there is none or the file has changed since it was stored
+   */
+  bool lookup(const int fd, struct stat const& st, const Streebog::Mode mode, void* digest);
+
+  /**
+   * @brief remembers the digest of the file hashed in the state before describes
+   */
+  void store(const int fd, struct stat const& before, const Streebog::Mode mode, void const* digest);
+
+ private:
+  struct KeyHash {
+    size_t operator()(Key const& k) const { return k.ino * 0x9e3779b97f4a7c15ULL ^ k.dev ^ k.mode; }
+  };
+
+  std::string db;
+  std::mutex mtx;
+  std::unordered_map<Key, Entry, KeyHash> entries;
+  bool dirty{};
+};
+
+/**
+ * @brief hash_fd() going through opt.cache and, with opt.checkpoint, resuming from the checkpoints kept in the
+ * user.streebog.ckpt.256 or user.streebog.ckpt.512 attribute (see hash_fd_checkpointed()); both apply to regular
+ * files read from the start only
+ */
+int hash_fd_cached(const int fd, const Streebog::Mode mode, void* digest, Options const& opt);
+
+/**
+ * @brief one file to hash and, once hashed, its result
+ */
+struct FileJob {
+  std::string path;
+  Streebog::Mode mode;
+  int err{};                       ///< errno value of the failed hashing
+  alignas(32) uint8_t digest[64];  ///< result in the layout of Streebog::operator()
+};
+
+/**
+ * @brief runs f(i) for i in [0, count) on a pool of opt.threads threads (one per hardware thread by default)
+ */
+void parallel_for(const uint64_t count, Options const& opt, std::function<void(uint64_t)> const& f);
+
+/**
+ * @brief hashes files on a pool of threads
+ * @details
+ * All files are stat()ed first, on the pool as well, and scheduled largest first, so the wall time tends to the time
+ * of the largest file rather than to whatever file happened to be taken last. Files smaller than 64KB are read and
+ * hashed by one worker in groups, which feeds them to the multi-lane kernel (see streebog_batch()). With
+ * ReadMethod::Uring and no checkpoints, files smaller than 4MB are grouped too and go through one io_uring reader,
+ * which keeps reads of the whole group in flight (see hash_fds())
+ * @param jobs files to hash, results are written into them
+ * @param opt threads, method and keep_order are used
+ * @param on_done called on the calling thread for the index of every hashed job, in completion order or, with
+ * keep_order, in the order of jobs; returning false stops the hashing (jobs not started are never reported)
+ */
+void hash_parallel(std::vector<FileJob>& jobs, Options const& opt, std::function<bool(uint64_t)> const& on_done);
+
+/**
+ * @brief prints a "HASH  NAME" line, escaping the name the way coreutils do
+ */
+void print_line(char const* hex, std::string const& name);
+
+/**
+ * @brief prints a name as the last field of a tab separated line: backslash, tab, CR and LF are written as `\\`,
+ * `\t`, `\r` and `\n`, so the line always splits into the same number of fields
+ */
+void print_field(std::string const& name);
+
+/**
+ * @brief parses a manifest line "HASH  NAME" or "HASH *NAME", possibly escaped with a leading backslash
+ * @param line line without the trailing '\n', a trailing '\r' is ignored
+ * @param len line length
+ * @param opt with mode_set, lines of the other mode are rejected
+ * @param job receives the unescaped name and the mode given by the hash length
+ * @param expected receives the hash in the layout of Streebog::operator()
+ * @return false if the line is improperly formatted
+ */
+bool parse_check_line(char const* line, uint64_t len, Options const& opt, FileJob& job, uint8_t* expected);
+
+/**
+ * @brief --check mode: verifies files listed in a manifest
+ * @details
+ * The manifest is read and verified in windows of 16384 lines, so the memory does not grow with its length and the
+ * first results are printed before it is read in full; --keep-order holds across the windows.
+ * @param manifest manifest path, - for stdin
+ * @return exit status
+ */
+int check(char const* manifest, Options const& opt);
+
+using WalkFile = std::function<void(int dfd, char const* name, std::string path)>;
+using WalkError = std::function<void(std::string const& path, int err)>;
+
+/**
+ * @brief walks a directory tree with getdents64, shared by -r and --dupes
+ * @details
+ * The entries of every directory are visited in name order, subdirectories in place. Entries without d_type are
+ * fstatat()ed. Symbolic links, devices, sockets etc. are skipped.
+ * @param dfd directory fd, closed here
+ * @param prefix path of the directory with a trailing slash
+ * @param on_file called for every regular file with the fd of its directory, its name and its path
+ * @param on_error called with the path and errno value of a directory which cannot be opened or read
+ */
+void walk_dir(const int dfd, std::string const& prefix, WalkFile const& on_file, WalkError const& on_error);
+
+/**
+ * @brief -r mode: hashes every regular file under the given roots
+ * @details
+ * A walker thread reads directories with getdents64 and opens files relative to the directory fd, so no path is
+ * resolved twice. Files are hashed by a pool of workers while the walk goes on and printed in a deterministic
+ * order (entries of every directory sorted by name). At most a fixed window of files (4096, but no more than half
+ * of RLIMIT_NOFILE, as each holds an open descriptor) is in flight, so neither memory nor descriptors grow with the
+ * size of the tree. Symbolic links are not followed.
+ * @return exit status
+ */
+int hash_tree(char const* const* roots, const int count, Options const& opt);
+
+/**
+ * @brief --dupes mode: finds regular files with the same contents under the given roots
+ * @details
+ * Files are narrowed down in stages, each run only on the files still colliding after the previous one: equal size,
+ * then the Streebog-256 of the first and the last 64KB (the whole hash for files up to 128KB), then the full
+ * Streebog-256 on the hash_parallel() pool. Most files of a tree have a unique size or differ near an end, so only
+ * real duplicates and rare near-misses are read in full. The roots are walked with walk_dir() and the files found
+ * are stat()ed on the parallel_for() pool; only the walk itself and the sort by size, which reads no files, are
+ * serial. Several names of one inode are counted once. Symbolic links are not followed.
+ * @return exit status
+ */
+int find_dupes(char const* const* roots, const int count, Options const& opt);
@@ -0,0 +1,136 @@
+/**
+ * @file    stbgdelta.cc
+ * @brief   stbgdelta - command-line utility making and applying rsync-style deltas of files
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "delta.hh"
+
+static void usage(FILE* f, const char* prog) {
+  fprintf(f,
+          "Usage: %s [OPTION]... signature BASIS SIGNATURE\n"
+          "  or:  %s [OPTION]... delta SIGNATURE NEW DELTA\n"
+          "  or:  %s [OPTION]... patch BASIS DELTA NEW\n"
+          "Make a signature of BASIS, describe NEW as a DELTA against that signature,\n"
+          "or rebuild NEW from BASIS and DELTA. Any FILE but BASIS of patch may be -\n"
+          "for standard input or output.\n"
+          "\n"
+          "  -b, --block=BYTES     signature block size (default - square root of the size)\n"
+          "  -s, --strong=BYTES    bytes of Streebog-256 kept per block, 1 to 32 (default 16)\n"
+          "  -v, --verbose         print the number of copied and literal bytes of a delta\n"
+          "  -h, --help            display this help and exit\n"
+          "\n"
+          "patch checks the Streebog-256 of NEW recorded in DELTA and fails if it differs.\n",
+          prog, prog, prog);
+}
+
+/**
+ * @brief opens a file of a command, - is stdin or stdout
+ */
+static int open_arg(char const* prog, char const* path, const bool write) {
+  if (!strcmp(path, "-")) return (write ? STDOUT_FILENO : STDIN_FILENO);
+  const int fd = (write ? open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666)
+                        : open(path, O_RDONLY | O_CLOEXEC));
+  if (fd < 0) fprintf(stderr, "%s: %s: %s\n", prog, path, strerror(errno));
+  return fd;
+}
+
+/**
+ * @brief closes a file opened by open_arg(), keeping the first error
+ */
+static void close_arg(const int fd, int& err) {
+  if (fd > STDERR_FILENO && close(fd) && !err) err = errno;  // NFS and friends report write errors on close
+}
+
+int main(int argc, char** argv) {
+  static const option longopts[] = {{"block", required_argument, nullptr, 'b'},
+                                    {"strong", required_argument, nullptr, 's'},
+                                    {"verbose", no_argument, nullptr, 'v'},
+                                    {"help", no_argument, nullptr, 'h'},
+                                    {nullptr, 0, nullptr, 0}};
+
+  uint32_t block{}, strong{};
+  bool verbose{};
+  for (int c; (c = getopt_long(argc, argv, "b:s:vh", longopts, nullptr)) != -1;) {
+    switch (c) {
+      case 'b':
+        block = strtoul(optarg, nullptr, 10);
+        break;
+      case 's':
+        strong = strtoul(optarg, nullptr, 10);
+        if (!strong || strong > 32) {
+          fprintf(stderr, "%s: invalid strong hash length '%s', expected 1 to 32\n", argv[0], optarg);
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'v':
+        verbose = true;
+        break;
+      case 'h':
+        usage(stdout, argv[0]);
+        return EXIT_SUCCESS;
+      default:
+        usage(stderr, argv[0]);
+        return EXIT_FAILURE;
+    }
+  }
+
+  const int n = argc - optind;
+  char const* cmd = (n ? argv[optind] : "");
+  char** args = argv + optind + 1;
+  const bool sig_cmd = !strcmp(cmd, "signature"), delta_cmd = !strcmp(cmd, "delta"), patch_cmd = !strcmp(cmd, "patch");
+  if (!((sig_cmd && n == 3) || ((delta_cmd || patch_cmd) && n == 4))) {
+    usage(stderr, argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  // the first argument is read, the last one is written; delta reads two files
+  const int in = open_arg(argv[0], args[0], false);
+  if (in < 0) return EXIT_FAILURE;
+  const int in2 = (sig_cmd ? -1 : open_arg(argv[0], args[1], false));
+  const int out = (sig_cmd || in2 >= 0 ? open_arg(argv[0], args[n - 2], true) : -1);
+  int err{};
+  if (in2 < 0 && !sig_cmd) {
+    close_arg(in, err);
+    return EXIT_FAILURE;
+  }
+  if (out < 0) {
+    close_arg(in, err), close_arg(in2, err);
+    return EXIT_FAILURE;
+  }
+
+  Signature sig;
+  DeltaStats stats{};
+  if (sig_cmd) {
+    err = make_signature(in, block, strong, sig);
+    if (!err) err = write_signature(out, sig);
+  } else if (delta_cmd) {
+    err = read_signature(in, sig);
+    if (!err) err = make_delta(sig, in2, out, &stats);
+  } else {
+    err = apply_delta(in, in2, out);
+  }
+  close_arg(out, err), close_arg(in2, err), close_arg(in, err);
+
+  if (err) {
+    fprintf(stderr, "%s: %s: %s\n", argv[0], cmd,
+            (err == EBADMSG && patch_cmd ? "delta is corrupted or BASIS is not the file it was made for"
+                                         : strerror(err)));
+    return EXIT_FAILURE;
+  }
+  if (verbose && delta_cmd)
+    fprintf(stderr, "%s: copied %llu bytes, literal %llu bytes\n", argv[0], (unsigned long long)stats.copied,
+            (unsigned long long)stats.literal);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,237 @@
+/**
+ * @file    walk.cc
+ * @brief   -r mode of the stbg utility: hashing of directory trees
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "stbg.hh"
+
+using ui64 = uint64_t;
+
+static constexpr ui64 WINDOW = 4096;  ///< max number of files between the walker and the printer
+
+/**
+ * @brief WINDOW limited to half of RLIMIT_NOFILE: every file in flight holds a descriptor, the rest is left for the
+ * directories being walked, the workers and stdio
+ */
+static ui64 window_size() {
+  struct rlimit rl;
+  if (getrlimit(RLIMIT_NOFILE, &rl) || rl.rlim_cur == RLIM_INFINITY) return WINDOW;
+  const ui64 share = rl.rlim_cur / 2;
+  return (share < 8 ? 8 : share > WINDOW ? WINDOW : share);
+}
+
+namespace {
+  struct linux_dirent64 {
+    ino64_t d_ino;
+    off64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+  };
+}  // namespace
+
+/**
+ * @param dents getdents64 buffer shared by the whole walk, names are copied out before recursion
+ */
+static void walk_dir(const int dfd, std::string const& prefix, std::vector<char>& dents, WalkFile const& on_file,
+                     WalkError const& on_error) {
+  std::vector<std::pair<std::string, unsigned char>> names;
+  for (long n; (n = syscall(SYS_getdents64, dfd, dents.data(), dents.size())) != 0;) {
+    if (n < 0) {
+      on_error(prefix, errno);
+      break;
+    }
+    for (long off{}; off < n;) {
+      auto d = (linux_dirent64*)(dents.data() + off);
+      off += d->d_reclen;
+      if (strcmp(d->d_name, ".") && strcmp(d->d_name, "..")) names.emplace_back(d->d_name, d->d_type);
+    }
+  }
+  std::sort(names.begin(), names.end());
+
+  for (auto& [name, type] : names) {
+    if (type == DT_UNKNOWN) {  // the file system does not fill d_type
+      struct stat st;
+      if (fstatat(dfd, name.c_str(), &st, AT_SYMLINK_NOFOLLOW)) continue;
+      type = (S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_LNK);
+    }
+
+    if (type == DT_DIR) {
+      const int sub = openat(dfd, name.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+      if (sub < 0)
+        on_error(prefix + name, errno);
+      else
+        walk_dir(sub, prefix + name + '/', dents, on_file, on_error);
+    } else if (type == DT_REG) {  // symlinks, devices, sockets etc. are not followed
+      on_file(dfd, name.c_str(), prefix + name);
+    }
+  }
+
+  close(dfd);
+}
+
+void walk_dir(const int dfd, std::string const& prefix, WalkFile const& on_file, WalkError const& on_error) {
+  std::vector<char> dents(1 << 16);
+  walk_dir(dfd, prefix, dents, on_file, on_error);
+}
+
+namespace {
+  struct Entry {
+    std::string path;
+    int fd;   ///< opened by the walker relative to its directory, closed by the hashing worker
+    int err;  ///< errno of open or hashing
+    bool done;
+    alignas(32) uint8_t digest[64];
+  };
+
+  /**
+   * @brief walker -> workers -> printer pipeline over a ring of window_size() entries
+   */
+  struct Tree {
+    Options const& opt;
+    const ui64 window = window_size();
+    std::vector<Entry> ring = std::vector<Entry>(window);
+    std::mutex mtx;
+    std::condition_variable walker_cv, worker_cv, printer_cv;
+    std::deque<ui64> todo;
+    ui64 produced{}, printed{};
+    bool walked{};
+    std::atomic<int> status{EXIT_SUCCESS};
+
+    explicit Tree(Options const& _opt) : opt{_opt} {}
+
+    void emit(std::string path, const int fd, const int err) {
+      std::unique_lock lk{mtx};
+      walker_cv.wait(lk, [&] { return produced - printed < window; });
+      auto& e = ring[produced % window];
+      e.path = std::move(path), e.fd = fd, e.err = err, e.done = (fd < 0);
+      if (fd >= 0)
+        todo.push_back(produced), worker_cv.notify_one();
+      else
+        printer_cv.notify_one();
+      produced++;
+    }
+
+    /**
+     * @brief emits the regular files under a directory, opened relative to their directories
+     * @param dfd directory fd, closed here
+     * @param prefix path of the directory with a trailing slash
+     */
+    void walk(const int dfd, std::string const& prefix) {
+      walk_dir(
+          dfd, prefix,
+          [&](const int parent, char const* name, std::string path) {
+            const int fd = openat(parent, name, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+            emit(std::move(path), fd, (fd < 0 ? errno : 0));
+          },
+          [&](std::string const& path, const int err) {
+            fprintf(stderr, "%s: %s: %s\n", opt.prog, path.c_str(), strerror(err));
+            status = EXIT_FAILURE;
+          });
+    }
+
+    void hash_worker() {
+      for (;;) {
+        ui64 seq;
+        {
+          std::unique_lock lk{mtx};
+          worker_cv.wait(lk, [&] { return !todo.empty() || walked; });
+          if (todo.empty()) return;
+          seq = todo.front();
+          todo.pop_front();
+        }
+
+        auto& e = ring[seq % window];
+        e.err = hash_fd_cached(e.fd, opt.mode, e.digest, opt);
+        close(e.fd);
+
+        std::lock_guard lk{mtx};
+        e.done = true;
+        if (seq == printed) printer_cv.notify_one();
+      }
+    }
+
+    void print() {
+      char hex[129];
+      for (;;) {
+        std::unique_lock lk{mtx};
+        printer_cv.wait(lk, [&] {
+          return (printed < produced && ring[printed % window].done) || (walked && printed == produced);
+        });
+        if (printed == produced) return;
+
+        auto& e = ring[printed % window];
+        lk.unlock();
+        if (e.err) {
+          fflush(stdout);
+          fprintf(stderr, "%s: %s: %s\n", opt.prog, e.path.c_str(), strerror(e.err));
+          status = EXIT_FAILURE;
+        } else {
+          digest_to_hex(e.digest, opt.mode, hex);
+          print_line(hex, e.path);
+        }
+        lk.lock();
+
+        printed++;
+        walker_cv.notify_one();
+      }
+    }
+  };
+}  // namespace
+
+int hash_tree(char const* const* roots, const int count, Options const& opt) {
+  Tree tree{opt};
+
+  ui64 threads = (opt.threads ? opt.threads : std::thread::hardware_concurrency());
+  std::vector<std::thread> workers;
+  for (ui64 t{}; t < (threads ? threads : 1); t++) workers.emplace_back([&] { tree.hash_worker(); });
+
+  std::thread walker([&] {
+    for (int i{}; i < count; i++) {
+      std::string root = roots[i];
+      const int fd = open(roots[i], O_RDONLY | O_CLOEXEC);
+      struct stat st;
+      if (fd < 0 || fstat(fd, &st)) {
+        tree.emit(root, -1, errno);
+        if (fd >= 0) close(fd);
+      } else if (S_ISDIR(st.st_mode)) {
+        tree.walk(fd, (root.back() == '/' ? root : root + '/'));
+      } else {
+        tree.emit(root, fd, 0);
+      }
+    }
+
+    std::lock_guard lk{tree.mtx};
+    tree.walked = true;
+    tree.worker_cv.notify_all();
+    tree.printer_cv.notify_one();
+  });
+
+  tree.print();
+  walker.join();
+  for (auto& w : workers) w.join();
+
+  return tree.status;
+}
@@ -0,0 +1,108 @@
+/**
+ * @file    tree.cc
+ * @brief   Implementation of the Streebog-Tree hash
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#include "tree.hh"
+
+#include <endian.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using ui64 = uint64_t;
+
+static constexpr uint8_t LEAF_TAG = 0x00;  ///< prefix of a leaf
+static constexpr uint8_t NODE_TAG = 0x01;  ///< prefix of a node
+static constexpr uint8_t ROOT_TAG = 0x02;  ///< prefix of the result
+
+int hash_tree_leaves(const int fd, const Streebog::Mode mode, const ui64 start, const ui64 size,
+                     TreeConfig const& cfg, std::vector<ui64> const& idx, std::function<void*(ui64)> const& out) {
+  constexpr ui64 L = Streebog::LANES;
+  const ui64 groups = (idx.size() + L - 1) / L;
+  ui64 threads = (cfg.threads ? cfg.threads : std::thread::hardware_concurrency());
+  threads = std::max<ui64>(1, std::min(threads, groups));
+
+  std::atomic<ui64> next{};
+  std::atomic<int> err{};
+  auto worker = [&] {
+    const ui64 stride = cfg.leaf + 1;  // the tag, then the leaf
+    std::vector<uint8_t> buf(L * stride);
+    for (ui64 g; !err && (g = next.fetch_add(1)) < groups;) {
+      void const* ptr[L];
+      void* dst[L];
+      ui64 len[L], k{};
+      for (; k < L && g * L + k < idx.size(); k++) {
+        const ui64 i = idx[g * L + k], off = i * cfg.leaf;
+        uint8_t* p = buf.data() + k * stride;
+        const ui64 n = std::min(cfg.leaf, size - std::min(size, off));
+        p[0] = LEAF_TAG, ptr[k] = p, len[k] = n + 1, dst[k] = out(i);
+        for (ui64 got{}; got < n;) {
+          auto r = pread(fd, p + 1 + got, n - got, start + off + got);
+          if (r < 0 && errno == EINTR) continue;
+          if (r <= 0) {
+            int expected{};
+            err.compare_exchange_strong(expected, (r ? errno : EIO));  // EIO: the file has shrunk meanwhile
+            return;
+          }
+          got += r;
+        }
+      }
+      streebog_batch(mode, k, ptr, len, dst);
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (ui64 t = 1; t < threads; t++) pool.emplace_back(worker);
+  worker();
+  for (auto& t : pool) t.join();
+  return err;
+}
+
+int hash_fd_tree(const int fd, const Streebog::Mode mode, void* out, TreeConfig const& cfg) {
+  if (!cfg.leaf) return EINVAL;
+  const off_t start = lseek(fd, 0, SEEK_CUR);
+  if (start < 0) return errno;
+  const off_t end = lseek(fd, 0, SEEK_END);  // st_size is 0 for block devices
+  if (end < 0) return errno;
+
+  const ui64 d = Streebog::digest_size(mode), size = (end > start ? end - start : 0);
+  std::vector<ui64> idx(std::max<ui64>(1, (size + cfg.leaf - 1) / cfg.leaf));
+  for (ui64 i{}; i < idx.size(); i++) idx[i] = i;
+  std::vector<uint8_t> level(idx.size() * d);
+  if (int e = hash_tree_leaves(fd, mode, start, size, cfg, idx, [&](const ui64 i) { return level.data() + i * d; }))
+    return e;
+
+  // every level is one batch over tagged copies of the child pairs; the nodes are few next to the leaves
+  std::vector<uint8_t> in;
+  std::vector<void const*> ptr;
+  std::vector<void*> dst;
+  for (ui64 width = level.size() / d; width > 1; width = (width + 1) / 2) {
+    const ui64 pairs = width / 2;
+    in.resize(pairs * (2 * d + 1)), ptr.resize(pairs), dst.resize(pairs);
+    for (ui64 p{}; p < pairs; p++) {
+      in[p * (2 * d + 1)] = NODE_TAG;
+      memcpy(in.data() + p * (2 * d + 1) + 1, level.data() + 2 * p * d, 2 * d);
+      ptr[p] = in.data() + p * (2 * d + 1), dst[p] = level.data() + p * d;
+    }
+    const std::vector<ui64> len(pairs, 2 * d + 1);
+    streebog_batch(mode, pairs, ptr.data(), len.data(), dst.data());
+    if (width & 1) memmove(level.data() + pairs * d, level.data() + (width - 1) * d, d);  // carried up
+  }
+
+  uint8_t root[1 + 16 + 64];
+  const ui64 h[] = {htole64(cfg.leaf), htole64(size)};
+  root[0] = ROOT_TAG;
+  memcpy(root + 1, h, 16), memcpy(root + 17, level.data(), d);
+  Streebog{mode}(root, 17 + d, out);
+  return 0;
+}
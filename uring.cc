@@ -0,0 +1,245 @@
+/**
+ * @file    uring.cc
+ * @brief   Implementation of the io_uring based file reader
+ * @author  https://github.com/gdaneek
+ * @date    30.05.2025
+ * @version 2.3.1
+ * @see https://github.com/gdaneek/streebog-hash
+ */
+
+#include "uring.hh"
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <deque>
+#include <vector>
+
+#include "file.hh"
+
+using ui64 = uint64_t;
+
+static constexpr ui64 ALIGN = 1ULL << 12;
+
+struct UringReader::Buffer {
+  uint32_t stream;  ///< index of the owning stream
+  ui64 off;         ///< file offset of the read
+  int64_t res;      ///< bytes read or -errno
+  bool done;
+};
+
+struct UringReader::Stream {
+  int fd;
+  ui64 end;   ///< offset to stop at
+  ui64 next;  ///< offset of the next read to submit
+  int err;
+  StreebogStream* ctx;
+  std::deque<uint32_t> bufs;  ///< buffers in flight or completed, in offset order
+};
+
+UringReader::UringReader(Config _cfg) : cfg{_cfg} {
+  if (!cfg.depth) cfg.depth = 1;
+  cfg.chunk = (cfg.chunk + ALIGN - 1) & ~(ALIGN - 1);
+
+  io_uring_params p;
+  memset(&p, 0, sizeof(p));
+  const int fd = syscall(__NR_io_uring_setup, cfg.depth, &p);
+  if (fd < 0) return;
+
+  sq_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  cq_sz = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+  if (p.features & IORING_FEAT_SINGLE_MMAP) sq_sz = cq_sz = (sq_sz > cq_sz ? sq_sz : cq_sz);
+  sqes_sz = p.sq_entries * sizeof(io_uring_sqe);
+
+  sq_ptr = mmap(nullptr, sq_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  cq_ptr = (p.features & IORING_FEAT_SINGLE_MMAP
+                ? sq_ptr
+                : mmap(nullptr, cq_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING));
+  sqes = mmap(nullptr, sqes_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (sq_ptr == MAP_FAILED || cq_ptr == MAP_FAILED || sqes == MAP_FAILED ||
+      posix_memalign((void**)&pool, ALIGN, cfg.depth * cfg.chunk)) {
+    if (sq_ptr != MAP_FAILED) munmap(sq_ptr, sq_sz);
+    if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr) munmap(cq_ptr, cq_sz);
+    if (sqes != MAP_FAILED) munmap(sqes, sqes_sz);
+    close(fd);
+    return;
+  }
+
+  auto at = [](void* base, const unsigned off) { return (unsigned*)((uint8_t*)base + off); };
+  sq_head = at(sq_ptr, p.sq_off.head), sq_tail = at(sq_ptr, p.sq_off.tail);
+  sq_mask = at(sq_ptr, p.sq_off.ring_mask), sq_array = at(sq_ptr, p.sq_off.array);
+  cq_head = at(cq_ptr, p.cq_off.head), cq_tail = at(cq_ptr, p.cq_off.tail);
+  cq_mask = at(cq_ptr, p.cq_off.ring_mask), cqes = (uint8_t*)cq_ptr + p.cq_off.cqes;
+
+  std::vector<iovec> iov(cfg.depth);
+  for (uint32_t i{}; i < cfg.depth; i++) iov[i] = {pool + i * cfg.chunk, cfg.chunk};
+  fixed = !syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, iov.data(), cfg.depth);  // needs memlock
+  ring_fd = fd;
+}
+
+UringReader::~UringReader() {
+  if (ring_fd < 0) return;
+  munmap(sqes, sqes_sz);
+  if (cq_ptr != sq_ptr) munmap(cq_ptr, cq_sz);
+  munmap(sq_ptr, sq_sz);
+  close(ring_fd);
+  free(pool);
+}
+
+bool UringReader::submit(const uint32_t buf, const int fd, const ui64 off, const uint32_t len) {
+  const unsigned tail = *sq_tail;
+  if (tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) > *sq_mask) return false;  // the queue is full
+
+  const unsigned idx = tail & *sq_mask;
+  auto sqe = (io_uring_sqe*)sqes + idx;
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = (fixed ? IORING_OP_READ_FIXED : IORING_OP_READ);
+  sqe->fd = fd;
+  sqe->addr = (ui64)(pool + buf * cfg.chunk);
+  sqe->len = len;
+  sqe->off = off;
+  sqe->buf_index = (fixed ? buf : 0);
+  sqe->user_data = buf;
+  sq_array[idx] = idx;
+  __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+  to_submit++;
+
+  return true;
+}
+
+int UringReader::reap(Buffer* bufs) {
+  while (syscall(__NR_io_uring_enter, ring_fd, to_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0)
+    if (errno != EINTR) return errno;
+  to_submit = 0;
+
+  unsigned head = *cq_head;
+  const unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+  for (; head != tail; head++) {
+    auto cqe = (io_uring_cqe*)cqes + (head & *cq_mask);
+    auto& b = bufs[cqe->user_data];
+    b.res = cqe->res, b.done = true;
+  }
+  __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+  return 0;
+}
+
+void UringReader::read(Stream* streams, const ui64 count) {
+  std::vector<Buffer> bufs(cfg.depth);
+  std::vector<uint32_t> free_bufs;
+  for (uint32_t i = cfg.depth; i--;) free_bufs.push_back(i);
+
+  std::vector<ui64> active;  ///< streams being read
+  ui64 started{}, inflight{};
+  while (active.size() < cfg.depth && started < count) active.push_back(started++);
+
+  while (!active.empty()) {
+    for (bool more = true; more && !free_bufs.empty();) {  // one read per stream per pass
+      more = false;
+      for (auto i : active) {
+        auto& s = streams[i];
+        if (s.err || s.next >= s.end || free_bufs.empty()) continue;
+        const uint32_t b = free_bufs.back();
+        if (!submit(b, s.fd, s.next, (s.end - s.next < cfg.chunk ? s.end - s.next : cfg.chunk))) break;
+        free_bufs.pop_back();
+        bufs[b] = {(uint32_t)i, s.next, 0, false};
+        s.bufs.push_back(b);
+        s.next += cfg.chunk, inflight++, more = true;
+      }
+    }
+
+    if (inflight) {
+      if (auto e = reap(bufs.data())) {  // the ring itself is broken: fail everything being read
+        for (auto i : active)
+          for (auto b : streams[i].bufs) bufs[b].done = true, bufs[b].res = -e;
+      }
+    }
+
+    for (ui64 k{}; k < active.size();) {
+      auto& s = streams[active[k]];
+      while (!s.bufs.empty() && bufs[s.bufs.front()].done) {
+        const uint32_t b = s.bufs.front();
+        s.bufs.pop_front(), free_bufs.push_back(b), inflight--;
+        const int64_t res = bufs[b].res;
+        const ui64 want = (s.end - bufs[b].off < cfg.chunk ? s.end - bufs[b].off : cfg.chunk);
+        if (s.err) continue;  // drain the reads issued before the failure
+        if (res < 0) {
+          s.err = -res;
+          continue;
+        }
+
+        auto p = pool + b * cfg.chunk;
+        ui64 got = res;
+        while (got < want) {  // short read in the middle of the range: finish the chunk synchronously
+          // from the last aligned offset, as an O_DIRECT fd reads only into aligned buffers at aligned offsets
+          const ui64 from = got & ~(ALIGN - 1);
+          auto n = pread(s.fd, p + from, want - from, bufs[b].off + from);
+          if (n < 0 && errno == EINTR) continue;
+          if (n < 0) s.err = errno;
+          if (n <= 0 || (ui64)n <= got - from) break;  // nothing new: the end of the file
+          got = from + n;
+        }
+        s.ctx->update(p, got);
+        if (got < want) s.end = bufs[b].off + got;  // the file has shrunk
+      }
+
+      if (s.bufs.empty() && (s.err || s.next >= s.end)) {  // the stream is done
+        active.erase(active.begin() + k);
+        if (started < count) active.push_back(started++);
+        continue;
+      }
+      k++;
+    }
+  }
+}
+
+void UringReader::hash_fds(const ui64 count, int const* fd, const Streebog::Mode mode, void* const* out, int* err) {
+  if (!available()) {
+    for (ui64 i{}; i < count; i++) err[i] = hash_fd_pipelined(fd[i], mode, out[i]);
+    return;
+  }
+
+  std::vector<StreebogStream> ctx(count, StreebogStream{mode});
+  std::vector<Stream> streams;
+  std::vector<ui64> idx;  ///< file of every stream
+  for (ui64 i{}; i < count; i++) {
+    struct stat st;
+    const off_t off = lseek(fd[i], 0, SEEK_CUR);
+    if (!fstat(fd[i], &st) && S_ISREG(st.st_mode) && off >= 0) {
+      streams.push_back(Stream{fd[i], (ui64)st.st_size, (ui64)off, 0, &ctx[i], {}});
+      idx.push_back(i);
+    } else {
+      err[i] = ::hash_fd(fd[i], mode, out[i], ReadMethod::Read);
+    }
+  }
+
+  read(streams.data(), streams.size());
+
+  for (ui64 k{}; k < streams.size(); k++) {
+    auto& s = streams[k];
+    err[idx[k]] = s.err;
+    if (s.err) continue;
+    ctx[idx[k]].finalize(out[idx[k]]);
+    lseek(s.fd, s.end, SEEK_SET);
+  }
+}
+
+int UringReader::hash_fd(const int fd, const Streebog::Mode mode, void* out) {
+  int err{};
+  hash_fds(1, &fd, mode, &out, &err);
+  return err;
+}
+
+int UringReader::update(const int fd, const ui64 off, const ui64 size, StreebogStream& ctx) {
+  if (!available()) return ENOSYS;
+
+  Stream s{fd, off + size, off, 0, &ctx, {}};
+  read(&s, 1);
+  return s.err;
+}